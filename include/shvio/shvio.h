@@ -41,7 +41,10 @@ extern "C" {
  *
  * \subsection contents Contents
  *
- * - \link shvio.h shvio.h \endlink, \link vio_colorspace.h vio_colorspace.h \endlink:
+ * - \link shvio.h shvio.h \endlink, \link vio_colorspace.h vio_colorspace.h \endlink,
+ * \link vio_compose.h vio_compose.h \endlink, \link vio_buffer.h vio_buffer.h \endlink,
+ * \link vio_stream.h vio_stream.h \endlink, \link vio_sched.h vio_sched.h \endlink,
+ * \link vio_trace.h vio_trace.h \endlink:
  * Documentation of the SHVIO C API
  *
  * - \link configuration Configuration \endlink:
@@ -137,6 +140,11 @@ SHVIO *shvio_open_named(const char *name);
 void shvio_close(SHVIO *vio);
 
 #include <shvio/vio_colorspace.h>
+#include <shvio/vio_compose.h>
+#include <shvio/vio_buffer.h>
+#include <shvio/vio_stream.h>
+#include <shvio/vio_sched.h>
+#include <shvio/vio_trace.h>
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,170 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** \file
+ * Buffer management: importing buffers for use by the hardware
+ */
+
+#ifndef __VIO_BUFFER_H__
+#define __VIO_BUFFER_H__
+
+#include <stddef.h>
+
+/** Import a dma-buf so that surfaces in it are used without copying.
+ * The buffer is mapped into the process and its physical address is
+ * registered with UIOMux once, so set-up only needs an address lookup.
+ * Plane pointers of surfaces in the buffer are the returned address plus
+ * the plane offset. The buffer must be physically contiguous.
+ *
+ * Looking up the physical address reads /proc/self/pagemap, which since
+ * Linux 4.2 only gives physical addresses to processes with CAP_SYS_ADMIN.
+ * An unprivileged process must pass the address supplied by the exporter.
+ * \param vio VIO handle
+ * \param fd dma-buf file descriptor. The caller keeps ownership of it.
+ * \param size Size of the buffer in bytes, or 0 to use the dma-buf size
+ * \param phys Physical address of the buffer if known by the exporter, or 0
+ * to look it up (which needs CAP_SYS_ADMIN)
+ * \retval 0 Failure, otherwise the address of the buffer
+ */
+void *
+shvio_dmabuf_import(
+	SHVIO *vio,
+	int fd,
+	size_t size,
+	unsigned long phys);
+
+/** Release a buffer imported with shvio_dmabuf_import.
+ * Imported buffers that are not released are released by shvio_close.
+ * \param vio VIO handle
+ * \param addr Address returned by shvio_dmabuf_import
+ */
+void
+shvio_dmabuf_release(
+	SHVIO *vio,
+	void *addr);
+
+/** Register a physically contiguous buffer with a VIO handle.
+ * The physical address of the buffer is looked up once, after which
+ * surfaces in the buffer are set up without querying UIOMux.
+ * \param vio VIO handle
+ * \param addr Address of the buffer
+ * \param size Size of the buffer in bytes
+ * \param phys Physical address of the buffer, or 0 to look it up
+ * \retval 0 Success
+ * \retval -1 Error: the buffer is not accessible by the hardware or overlaps
+ * a registered buffer
+ */
+int
+shvio_register_buffer(
+	SHVIO *vio,
+	void *addr,
+	size_t size,
+	unsigned long phys);
+
+/** Unregister a buffer registered with shvio_register_buffer.
+ * This must be called before the buffer is freed or unmapped.
+ * \param vio VIO handle
+ * \param addr Address of the buffer
+ */
+void
+shvio_unregister_buffer(
+	SHVIO *vio,
+	void *addr);
+
+/** Unregister all buffers of a VIO handle, e.g. after the mappings of the
+ * process have changed.
+ * \param vio VIO handle
+ */
+void
+shvio_invalidate_buffers(SHVIO *vio);
+
+/** Surface allocation flags */
+#define SHVIO_SURFACE_POW2_PITCH	(1 << 0)	/**< Power of two byte pitch, e.g. for MERAM */
+#define SHVIO_SURFACE_ALPHA		(1 << 1)	/**< Allocate an alpha plane */
+
+/** Allocate a surface the hardware can use without copying.
+ * All planes are in a single allocation, in the order Y, Cr (YV12/YV16 only),
+ * CbCr or Cb, then alpha. The pitch is chosen so that every line of every
+ * plane starts on a 32 byte boundary, and the byte pitches are set in the
+ * surface. The allocation is registered with the VIO handle.
+ * \param vio VIO handle
+ * \param surface Filled in with the allocated surface
+ * \param format Surface format
+ * \param w Width in pixels
+ * \param h Height in pixels
+ * \param flags SHVIO_SURFACE_* flags
+ * \retval 0 Success
+ * \retval -1 Error
+ */
+int
+shvio_surface_alloc(
+	SHVIO *vio,
+	struct ren_vid_surface *surface,
+	ren_vid_format_t format,
+	int w,
+	int h,
+	int flags);
+
+/** Free a surface allocated with shvio_surface_alloc.
+ * \param vio VIO handle
+ * \param surface Surface to free
+ */
+void
+shvio_surface_free(
+	SHVIO *vio,
+	struct ren_vid_surface *surface);
+
+/** Make CPU writes to part of a surface visible to the hardware.
+ * Call this after the CPU has written to a cached buffer, before the
+ * surface is used by an operation. Imported dma-bufs are synchronised with
+ * the dma-buf sync ioctl, other buffers by cache maintenance of the lines
+ * in the area where the platform supports it.
+ * \param vio VIO handle
+ * \param surface Surface
+ * \param rect Area to synchronise, or NULL for the whole surface
+ * \retval 0 Success
+ * \retval -1 Error: no cache maintenance is available for the buffer
+ */
+int
+shvio_surface_sync_for_device(
+	SHVIO *vio,
+	const struct ren_vid_surface *surface,
+	const struct ren_vid_rect *rect);
+
+/** Make hardware writes to part of a surface visible to the CPU.
+ * Call this after an operation has completed, before the CPU reads a
+ * cached buffer.
+ * \param vio VIO handle
+ * \param surface Surface
+ * \param rect Area to synchronise, or NULL for the whole surface
+ * \retval 0 Success
+ * \retval -1 Error: no cache maintenance is available for the buffer
+ */
+int
+shvio_surface_sync_for_cpu(
+	SHVIO *vio,
+	const struct ren_vid_surface *surface,
+	const struct ren_vid_rect *rect);
+
+#endif /* __VIO_BUFFER_H__ */
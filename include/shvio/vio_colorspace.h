@@ -34,7 +34,9 @@
  * BT.709, everything else BT.601.
  * MPEG standards use 'clamped' data with Y[16,235], CbCr[16,240]. JFIF file
  * format for JPEG specifies full-range data.
- * All YCbCr formats here are BT.601, Y[16,235], CbCr[16,240].
+ * YCbCr formats here default to BT.601, Y[16,235], CbCr[16,240]. This can be
+ * changed per handle with shvio_set_color_conversion, or per surface with the
+ * COLOR_STD_* and COLOR_RANGE_* flags.
  */
 
 /** Surface formats */
@@ -54,6 +56,10 @@ typedef enum {
 	REN_XRGB32,  /**< Packed XRGB8888 (most significant byte ignored) */
 	REN_BGRA32,  /**< Packed ABGR8888 */
 	REN_ARGB32,  /**< Packed ARGB8888 */
+	REN_NV21,    /**< YCbCr420: Y plane, packed CrCb plane, optional alpha plane */
+	REN_YUYV,    /**< YCbCr422i: packed YCbYCr plane, optional alpha plane */
+	REN_YVYU,    /**< YCbCr422i: packed YCrYCb plane, optional alpha plane */
+	REN_VYUY,    /**< YCbCr422i: packed CrYCbY plane, optional alpha plane */
 } ren_vid_format_t;
 
 
@@ -65,7 +71,9 @@ struct ren_vid_rect {
 	int h;      /**< Height of rectange in pixels */
 };
 
-/** Surface */
+/** Surface. Surfaces must be zero-initialised before their fields are set,
+ * for example with memset(), so that fields added in later versions (such as
+ * flags and window) are 0 and take their defaults. */
 struct ren_vid_surface {
 	ren_vid_format_t format; /**< Surface format */
 	int w;      /**< Width of active surface in pixels */
@@ -80,6 +88,7 @@ struct ren_vid_surface {
 	int bpitcha;  /**< Byte-pitch of Alpha plane (preferred than 'pitch', or ignored if 0) */
 	struct ren_vid_rect blend_out; /** Output window for blend operations */
 	int flags;
+	struct ren_vid_rect window; /**< Visible window for blend operations, only this area is read (ignored if w or h is 0) */
 };
 
 struct format_info {
@@ -108,6 +117,10 @@ static const struct format_info fmts[] = {
 	{ REN_XRGB32,  4, 0, 0, 1, 1, 1 },
 	{ REN_BGRA32,  4, 0, 0, 1, 1, 1 },
 	{ REN_ARGB32,  4, 0, 0, 1, 1, 1 },
+	{ REN_NV21,    1, 2, 1, 2, 2, 2 },
+	{ REN_YUYV,    2, 0, 0, 1, 1, 1 },
+	{ REN_YVYU,    2, 0, 0, 1, 1, 1 },
+	{ REN_VYUY,    2, 0, 0, 1, 1, 1 },
 };
 
 static inline int has_alpha(ren_vid_format_t fmt) {
@@ -118,6 +131,8 @@ static inline int is_ycbcr(ren_vid_format_t fmt)
 {
 	if (fmt >= REN_NV12 && fmt <= REN_UYVY)
 		return 1;
+	if (fmt >= REN_NV21 && fmt <= REN_VYUY)
+		return 1;
 	return 0;
 }
 
@@ -170,7 +185,9 @@ static inline size_t offset_y(ren_vid_format_t format, int w, int h, int pitch)
 static inline size_t offset_c(ren_vid_format_t format, int w, int h, int pitch)
 {
 	const struct format_info *fmt = &fmts[format];
-	return (fmt->c_bpp * (((h/fmt->c_ss_vert) * pitch/fmt->c_ss_horz) + w/fmt->c_ss_horz));
+	/* Planar formats split c_bpp across the Cb and Cr planes */
+	int bpp = is_ycbcr_planar(format) ? fmt->c_bpp / 2 : fmt->c_bpp;
+	return (bpp * (((h/fmt->c_ss_vert) * pitch/fmt->c_ss_horz) + w/fmt->c_ss_horz));
 }
 
 static inline size_t offset_a(ren_vid_format_t format, int w, int h, int pitch)
@@ -206,6 +223,7 @@ static inline void get_sel_surface(
 
 	if (in->py) out->py += offset_y(in->format, x, y, in->pitch);
 	if (in->pc) out->pc += offset_c(in->format, x, y, in->pitch);
+	if (in->pc2) out->pc2 += offset_c(in->format, x, y, in->pitch);
 	if (in->pa) out->pa += offset_a(in->format, x, y, in->pitch);
 }
 
@@ -233,6 +251,17 @@ typedef enum {
 #define BLEND_MODE_PREMULT	(1 << 0)
 #define BLEND_MODE_MASK		(1 << 0)
 
+/** Colour conversion flags, used when the surface is YCbCr.
+ * Unset values default to those given to shvio_set_color_conversion */
+#define COLOR_STD_DEFAULT	(0 << 4)
+#define COLOR_STD_BT601		(1 << 4)	/**< ITU-R BT.601 */
+#define COLOR_STD_BT709		(2 << 4)	/**< ITU-R BT.709 */
+#define COLOR_STD_MASK		(3 << 4)
+#define COLOR_RANGE_DEFAULT	(0 << 6)
+#define COLOR_RANGE_LIMITED	(1 << 6)	/**< Y[16,235], CbCr[16,240] */
+#define COLOR_RANGE_FULL	(2 << 6)	/**< YCbCr[0,255] */
+#define COLOR_RANGE_MASK	(3 << 6)
+
 
 /** Setup a (scale|rotate) & crop between YCbCr & RGB surfaces
  * The scaling factor is calculated from the surface sizes.
@@ -296,7 +325,9 @@ shvio_set_dst_phys(
 	unsigned int dst_py,
 	unsigned int dst_pc);
 
-/** Set the colour space conversion attributes.
+/** Set the default colour space conversion attributes.
+ * These apply to YCbCr surfaces that do not set COLOR_STD_* or COLOR_RANGE_*
+ * in their flags.
  * \param vio VIO handle
  * \param bt709 If true use ITU-R BT709, otherwise use ITU-R BT.601 (default)
  * \param full_range If true use YCbCr[0,255], otherwise use Y[16,235], CbCr[16,240] (default)
@@ -307,6 +338,27 @@ shvio_set_color_conversion(
 	int bt709,
 	int full_range);
 
+/** Colour correction matrix, applied to the output of an operation.
+ * Channels are ordered R/Cr, G/Y, B/Cb, and each output channel is
+ * out[i] = (coeff[i][0] * in[0] + coeff[i][1] * in[1] + coeff[i][2] * in[2]) / 2048 + offset[i]
+ */
+struct shvio_color_matrix {
+	int coeff[3][3];	/**< Coefficients, 2048 is 1.0 */
+	int offset[3];		/**< Offset added to each output channel */
+};
+
+/** Set a colour correction matrix for subsequent operations.
+ * Where the hardware supports it (VEU2H, YCbCr to RGB) the matrix is merged
+ * with the colour space conversion, otherwise it is applied by the CPU to the
+ * output, which must then be packed 24 or 32-bit RGB.
+ * \param vio VIO handle
+ * \param matrix Colour correction matrix, or NULL to remove it
+ */
+void
+shvio_set_color_matrix(
+	SHVIO *vio,
+	const struct shvio_color_matrix *matrix);
+
 /** Start a VIO operation (non-bundle mode).
  * \param vio VIO handle
  */
@@ -323,6 +375,17 @@ int
 shvio_has_bundle(
 	 SHVIO *vio);
 
+/** Check if the hardware supports a surface format.
+ * \param vio VIO handle
+ * \param format Surface format
+ * \retval 1 The format is supported
+ * \retval 0 The format is not supported
+ */
+int
+shvio_format_supported(
+	SHVIO *vio,
+	ren_vid_format_t format);
+
 /** Start a VIO operation (bundle mode).
  * \param vio VIO handle
  * \param bundle_lines Number of lines to process
@@ -333,7 +396,11 @@ shvio_start_bundle(
 	int bundle_lines);
 
 /** Wait for a VIO operation to complete. The operation is started by a call to shvio_start.
+ * In bundle mode, the lines of a completed stripe are copied to the
+ * destination while the next stripe is processed.
  * \param vio VIO handle
+ * \retval 1 The operation is complete
+ * \retval 0 A stripe is complete (bundle mode)
  */
 int
 shvio_wait(SHVIO *vio);
@@ -341,6 +408,7 @@ shvio_wait(SHVIO *vio);
 
 /** Perform scale between YCbCr & RGB surfaces.
  * This operates on entire surfaces and blocks until completion.
+ * See shvio_set_stripe() to split it up.
  *
  * \param vio VIO handle
  * \param src_surface Input surface
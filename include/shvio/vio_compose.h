@@ -0,0 +1,125 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** \file
+ * Incremental composition: only re-blend the damaged parts of a frame
+ */
+
+#ifndef __VIO_COMPOSE_H__
+#define __VIO_COMPOSE_H__
+
+/**
+ * An opaque handle to a compositor.
+ */
+struct SHVIO_COMPOSER;
+typedef struct SHVIO_COMPOSER SHVIO_COMPOSER;
+
+/** Maximum number of layers in a compositor */
+#define SHVIO_COMPOSER_MAX_LAYERS	4
+
+/** Compositor statistics */
+struct shvio_composer_stats {
+	unsigned long frames;		/**< Number of calls to shvio_composer_update */
+	unsigned long jobs;		/**< Jobs issued by the last update */
+	unsigned long long bytes;	/**< Bytes read and written by the last update */
+	unsigned long total_jobs;	/**< Jobs issued since the compositor was opened */
+	unsigned long long total_bytes;	/**< Bytes transferred since the compositor was opened */
+};
+
+/** Create a compositor that keeps its output in a persistent surface.
+ * The output surface must stay valid until the compositor is closed.
+ * \param vio VIO handle. The VIO must support blending.
+ * \param dst Output surface
+ * \retval 0 Failure, otherwise compositor handle
+ */
+SHVIO_COMPOSER *
+shvio_composer_open(
+	SHVIO *vio,
+	const struct ren_vid_surface *dst);
+
+/** Close a compositor.
+ * \param comp Compositor handle
+ */
+void
+shvio_composer_close(SHVIO_COMPOSER *comp);
+
+/** Set the layers to compose, bottom layer first. Each layer is placed
+ * in the output by its blend_out rectangle. The whole output is damaged.
+ * \param comp Compositor handle
+ * \param src_list List of layer surfaces
+ * \param src_count Number of layers, up to SHVIO_COMPOSER_MAX_LAYERS
+ * \retval 0 Success
+ * \retval -1 Error
+ */
+int
+shvio_composer_set_layers(
+	SHVIO_COMPOSER *comp,
+	const struct ren_vid_surface *const *src_list,
+	int src_count);
+
+/** Replace a single layer, e.g. to flip its buffer or move it.
+ * Both the old and the new position of the layer are damaged.
+ * \param comp Compositor handle
+ * \param layer Index of the layer
+ * \param src New layer surface
+ * \retval 0 Success
+ * \retval -1 Error
+ */
+int
+shvio_composer_set_layer(
+	SHVIO_COMPOSER *comp,
+	int layer,
+	const struct ren_vid_surface *src);
+
+/** Mark part of a layer as changed.
+ * \param comp Compositor handle
+ * \param layer Index of the layer
+ * \param rect Changed area in layer surface co-ordinates, or NULL for the whole layer
+ */
+void
+shvio_composer_damage(
+	SHVIO_COMPOSER *comp,
+	int layer,
+	const struct ren_vid_rect *rect);
+
+/** Re-compose the damaged areas of the output and clear the damage.
+ * This blocks until the output is up to date. If a blend fails, the areas
+ * not yet composed stay damaged for the next update.
+ * \param comp Compositor handle
+ * \retval 0 Success
+ * \retval -1 Error
+ */
+int
+shvio_composer_update(SHVIO_COMPOSER *comp);
+
+/** Get the compositor statistics.
+ * \param comp Compositor handle
+ * \param stats Filled in with the statistics
+ */
+void
+shvio_composer_get_stats(
+	SHVIO_COMPOSER *comp,
+	struct shvio_composer_stats *stats);
+
+#endif /* __VIO_COMPOSE_H__ */
@@ -0,0 +1,189 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** \file
+ * Sharing the hardware: priorities, timeouts and statistics
+ */
+
+#ifndef __VIO_SCHED_H__
+#define __VIO_SCHED_H__
+
+/** Phases of an operation, timed when enabled with shvio_enable_timing() */
+enum shvio_phase {
+	SHVIO_PHASE_BOUNCE_ALLOC,	/**< Getting surfaces the hardware can access */
+	SHVIO_PHASE_COPY_IN,	/**< Copying the source to a bounce buffer */
+	SHVIO_PHASE_LOCK,	/**< Waiting for the hardware, or on VIO6 for
+				     the entities of the operation */
+	SHVIO_PHASE_RESET,	/**< Stopping and resetting the hardware */
+	SHVIO_PHASE_PROGRAM,	/**< Programming the registers, including reset
+				     but not the wait for entities */
+	SHVIO_PHASE_HW,		/**< Start to completion on the hardware */
+	SHVIO_PHASE_SLEEP,	/**< Waiting for an interrupt */
+	SHVIO_PHASE_COPY_OUT,	/**< Colour matrix and copy from a bounce buffer */
+	SHVIO_PHASE_WAKE,	/**< End on the hardware to the wake-up, only
+				     timed with SHVIO_TIMING_WAKE */
+	SHVIO_NR_PHASES
+};
+
+/** What shvio_enable_timing() times */
+#define SHVIO_TIMING_PHASES	1	/**< The phases of operations */
+#define SHVIO_TIMING_WAKE	2	/**< The phases, and the wake-up latency */
+
+/** Number of histogram buckets per phase. Bucket 0 counts times under 1us,
+ * bucket n times from 2^(n-1) to 2^n - 1 us, and the last bucket everything
+ * longer. */
+#define SHVIO_HIST_BUCKETS	24
+
+/** Timing of a phase */
+struct shvio_phase_stats {
+	unsigned long count;		/**< Times the phase was timed */
+	unsigned long long total_us;	/**< Total time */
+	unsigned long max_us;		/**< Longest time */
+	unsigned long hist[SHVIO_HIST_BUCKETS]; /**< Histogram of the times */
+};
+
+/** Number of buckets of shvio_stats.sleeps_per_op. Bucket n counts
+ * operations that slept n times, and the last bucket those that slept more. */
+#define SHVIO_SLEEP_BUCKETS	8
+
+/** Statistics of a VIO handle */
+struct shvio_stats {
+	unsigned long allocs;		/**< Hardware entity allocations */
+	unsigned long alloc_waits;	/**< Allocations that had to wait */
+	unsigned long alloc_timeouts;	/**< Allocations that timed out */
+	unsigned long long alloc_wait_us; /**< Total time spent waiting for entities,
+					       or for the whole VEU */
+	unsigned long alloc_max_wait_us; /**< Longest wait for entities or the VEU */
+	unsigned long deadline_misses;	/**< Operations that missed their deadline */
+	unsigned long deadline_max_late_us; /**< Latest completion past a deadline */
+	unsigned long ops;		/**< Operations completed */
+	unsigned long failures;		/**< Operations abandoned after an error */
+	unsigned long sleeps;		/**< Sleeps waiting for an interrupt */
+	unsigned long spurious_wakeups;	/**< Wake-ups before the hardware was done */
+	unsigned long sleeps_per_op[SHVIO_SLEEP_BUCKETS]; /**< Histogram of the
+					     sleeps of each operation */
+	unsigned long polls;		/**< Waits for a state of the hardware
+					     that raises no interrupt */
+	unsigned long long poll_us;	/**< Total time spent polling */
+	unsigned long poll_max_us;	/**< Longest poll */
+	unsigned long poll_timeouts;	/**< Polls that gave up */
+	unsigned long recoveries;	/**< Resets of hardware that did not stop */
+	struct shvio_phase_stats phase[SHVIO_NR_PHASES]; /**< Phase timings */
+};
+
+/** Priority classes, for use with shvio_set_priority() */
+#define SHVIO_PRIO_BATCH	-10	/**< Background work, such as thumbnails */
+#define SHVIO_PRIO_NORMAL	0	/**< Default */
+#define SHVIO_PRIO_DISPLAY	10	/**< Work that must be done by the next vsync */
+
+/** Set the priority of subsequent operations. When several operations wait
+ * for the hardware, the one with the highest priority gets it first, and
+ * operations of the same priority get it in the order they asked for it.
+ * This holds between all handles using libshvio, in any process: VIO6
+ * operations wait for the entities they need, and VEU operations for the
+ * whole device.
+ * \param vio VIO handle
+ * \param priority Priority, 0 by default
+ */
+void
+shvio_set_priority(
+	SHVIO *vio,
+	int priority);
+
+/** Set how long an operation may wait for the hardware to become available.
+ * \param vio VIO handle
+ * \param timeout_ms Timeout in milliseconds, 0 to fail at once if the
+ *                   hardware is busy (default on VIO6), or -1 to wait
+ *                   forever (default on the VEU).
+ *                   An operation that needs more of the hardware than there
+ *                   is, such as more scaled blend layers than scalers,
+ *                   fails at once whatever the timeout.
+ */
+void
+shvio_set_timeout(
+	SHVIO *vio,
+	int timeout_ms);
+
+/** Set the deadline of subsequent operations. An operation that is not
+ * complete within deadline_us of being set up, including any wait for the
+ * hardware, is counted in shvio_stats.deadline_misses. The operation is
+ * still carried out to the end.
+ * \param vio VIO handle
+ * \param deadline_us Deadline in microseconds, or 0 for none (default)
+ */
+void
+shvio_set_deadline(
+	SHVIO *vio,
+	long deadline_us);
+
+/** Split subsequent shvio_resize() operations into stripes, each of which
+ * is a separate operation on the hardware. The hardware is given up between
+ * stripes, so that a waiting operation of higher priority runs after at most
+ * one stripe. Where the surfaces are scaled vertically, the seams between
+ * stripes may be visible.
+ * Only the first stripe is subject to the timeout set with
+ * shvio_set_timeout(); later ones wait for the hardware as long as needed.
+ * If a stripe fails, the rest are not processed, shvio_resize() returns -1
+ * and the operation is counted in shvio_stats.failures.
+ * \param vio VIO handle
+ * \param stripe_lines Destination lines per stripe, or 0 to process whole
+ *                     surfaces (default)
+ */
+void
+shvio_set_stripe(
+	SHVIO *vio,
+	int stripe_lines);
+
+/** Time the phases of subsequent operations. This costs a couple of clock
+ * reads per phase, so it is off by default.
+ * With SHVIO_TIMING_WAKE, a thread also spins on the status of each running
+ * operation to see when the hardware finishes, and the time until the
+ * interrupt wakes the caller is recorded as SHVIO_PHASE_WAKE. This takes a
+ * CPU of its own while the hardware runs, and without a spare CPU the
+ * latencies it records are not meaningful.
+ * \param vio VIO handle
+ * \param enable SHVIO_TIMING_PHASES or SHVIO_TIMING_WAKE to enable timing,
+ *               0 to disable it
+ */
+void
+shvio_enable_timing(
+	SHVIO *vio,
+	int enable);
+
+/** Get the statistics of a VIO handle.
+ * \param vio VIO handle
+ * \param stats Filled in with the statistics
+ */
+void
+shvio_get_stats(
+	SHVIO *vio,
+	struct shvio_stats *stats);
+
+/** Clear the statistics of a VIO handle.
+ * \param vio VIO handle
+ */
+void
+shvio_reset_stats(SHVIO *vio);
+
+#endif /* __VIO_SCHED_H__ */
@@ -0,0 +1,99 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** \file
+ * Line-sliced streaming: convert a frame while its source lines arrive
+ */
+
+#ifndef __VIO_STREAM_H__
+#define __VIO_STREAM_H__
+
+/**
+ * An opaque handle to a stream.
+ */
+struct SHVIO_STREAM;
+typedef struct SHVIO_STREAM SHVIO_STREAM;
+
+/** Called when destination lines of the current frame are complete.
+ * \param data The data passed to shvio_stream_open
+ * \param y First completed destination line
+ * \param lines Number of completed destination lines
+ */
+typedef void (*shvio_stream_callback_t)(void *data, int y, int lines);
+
+/** Create a stream. Each frame is converted from src to dst in slices of
+ * slice_lines source lines, which are started as soon as the producer has
+ * pushed enough lines. The VIO must support bundle mode.
+ * \param vio VIO handle
+ * \param src Source surface. src->h is the frame height. The source
+ *            buffers must be accessible by the hardware.
+ * \param dst Destination surface
+ * \param ring_lines Number of lines in the source buffers, which are used
+ *                   as a ring. Must be a multiple of slice_lines, or 0 if
+ *                   the source buffers hold a whole frame.
+ * \param slice_lines Number of source lines per slice
+ * \param callback Called for each completed part of the destination, or NULL
+ * \param data Passed to the callback
+ * \retval 0 Failure, otherwise stream handle
+ */
+SHVIO_STREAM *
+shvio_stream_open(
+	SHVIO *vio,
+	const struct ren_vid_surface *src,
+	const struct ren_vid_surface *dst,
+	int ring_lines,
+	int slice_lines,
+	shvio_stream_callback_t callback,
+	void *data);
+
+/** Close a stream, waiting for a frame in progress to complete.
+ * \param stream Stream handle
+ */
+void
+shvio_stream_close(SHVIO_STREAM *stream);
+
+/** Signal that more source lines of the current frame are ready. Full
+ * slices are started in order; the last slice started is left running.
+ * Once all the lines of a frame have been pushed, the next push waits for
+ * the frame to complete and starts the next frame.
+ * \param stream Stream handle
+ * \param lines Number of new source lines
+ * \retval -1 Error
+ * \retval >=0 Number of source lines of the frame the hardware has
+ *             finished reading. Their place in the ring may be refilled.
+ */
+int
+shvio_stream_push(
+	SHVIO_STREAM *stream,
+	int lines);
+
+/** Wait for the slice in progress and deliver its destination lines.
+ * \param stream Stream handle
+ * \retval 0 Success
+ * \retval -1 Error
+ */
+int
+shvio_stream_sync(SHVIO_STREAM *stream);
+
+#endif /* __VIO_STREAM_H__ */
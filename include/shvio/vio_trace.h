@@ -0,0 +1,62 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** \file
+ * Tracing register accesses
+ *
+ * Every register access of a traced handle is recorded in a ring buffer of
+ * the most recent accesses. Tracing is enabled for all handles by setting
+ * the environment variable SHVIO_TRACE to a value other than 0 before they
+ * are opened, or for one handle with shvio_trace_enable(). When enabled,
+ * the trace is written to stderr if an operation fails.
+ */
+
+#ifndef __VIO_TRACE_H__
+#define __VIO_TRACE_H__
+
+#include <stdio.h>
+
+/** Enable or disable tracing of the register accesses of a VIO handle.
+ * \param vio VIO handle
+ * \param enable 1 to enable tracing, 0 to disable it
+ * \retval 0 Success
+ * \retval -1 Error: Out of memory or too many open handles traced
+ */
+int
+shvio_trace_enable(
+	SHVIO *vio,
+	int enable);
+
+/** Write the recorded register accesses of a VIO handle, oldest first.
+ * This may be called while another thread is using the handle, for
+ * example to find out where it hangs.
+ * \param vio VIO handle
+ * \param fp Where to write the trace
+ */
+void
+shvio_trace_dump(
+	SHVIO *vio,
+	FILE *fp);
+
+#endif /* __VIO_TRACE_H__ */
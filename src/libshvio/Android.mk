@@ -8,7 +8,7 @@ LOCAL_C_INCLUDES := \
 #LOCAL_CFLAGS := -DDEBUG
 
 LOCAL_SRC_FILES := \
-	common.c veu.c vio6.c
+	buffer.c common.c compose.c dmabuf.c entity.c matrix.c stream.c surface.c trace.c veu.c vio6.c wake.c
 
 LOCAL_SHARED_LIBRARIES := libcutils \
 			  libuiomux
@@ -0,0 +1,410 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Registered buffers: a per-handle cache of virtual to physical translations
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#if defined(__sh__) && defined(__NR_cacheflush)
+#include <asm/cachectl.h>
+#endif
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+/* Registered ranges, sorted by virtual address and not overlapping */
+struct shvio_buffer {
+	unsigned long virt;
+	unsigned long phys;
+	size_t size;
+};
+
+/* Index of the first buffer that ends after virt */
+static int buffer_search(const SHVIO *vio, unsigned long virt)
+{
+	int lo = 0, hi = vio->nr_buffers;
+
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		const struct shvio_buffer *b = &vio->buffers[mid];
+
+		if (b->virt + b->size <= virt)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+int
+buffer_add(SHVIO *vio, void *addr, unsigned long phys, size_t size)
+{
+	unsigned long virt = (unsigned long)addr;
+	struct shvio_buffer *b;
+	int i;
+
+	i = buffer_search(vio, virt);
+	if (i < vio->nr_buffers && vio->buffers[i].virt < virt + size) {
+		debug_info("ERR: Buffer overlaps a registered buffer");
+		return -1;
+	}
+
+	if (vio->nr_buffers == vio->max_buffers) {
+		int max = vio->max_buffers ? vio->max_buffers * 2 : 8;
+
+		b = realloc(vio->buffers, max * sizeof(*b));
+		if (!b)
+			return -1;
+		vio->buffers = b;
+		vio->max_buffers = max;
+	}
+
+	b = &vio->buffers[i];
+	memmove(b + 1, b, (vio->nr_buffers - i) * sizeof(*b));
+	b->virt = virt;
+	b->phys = phys;
+	b->size = size;
+	vio->nr_buffers++;
+
+	return 0;
+}
+
+void
+buffer_remove(SHVIO *vio, void *addr)
+{
+	unsigned long virt = (unsigned long)addr;
+	struct shvio_buffer *b;
+	int i;
+
+	i = buffer_search(vio, virt);
+	if (i == vio->nr_buffers || vio->buffers[i].virt != virt)
+		return;
+
+	b = &vio->buffers[i];
+	memmove(b, b + 1, (vio->nr_buffers - i - 1) * sizeof(*b));
+	vio->nr_buffers--;
+}
+
+unsigned long
+vio_virt_to_phys(const SHVIO *vio, const void *addr)
+{
+	unsigned long virt = (unsigned long)addr;
+	const struct shvio_buffer *b;
+	int i;
+
+	if (!addr)
+		return 0;
+
+	i = buffer_search(vio, virt);
+	if (i < vio->nr_buffers) {
+		b = &vio->buffers[i];
+		if (b->virt <= virt)
+			return b->phys + (virt - b->virt);
+	}
+
+	/* Not registered with us, ask UIOMux */
+	return uiomux_all_virt_to_phys((void *)addr);
+}
+
+int
+shvio_register_buffer(
+	SHVIO *vio,
+	void *addr,
+	size_t size,
+	unsigned long phys)
+{
+	if (!vio || !addr || !size) {
+		debug_info("ERR: Invalid input - need buffer");
+		return -1;
+	}
+
+	if (!phys)
+		phys = uiomux_all_virt_to_phys(addr);
+	if (!phys) {
+		debug_info("ERR: Buffer is not accessible by hardware");
+		return -1;
+	}
+
+	return buffer_add(vio, addr, phys, size);
+}
+
+void
+shvio_unregister_buffer(
+	SHVIO *vio,
+	void *addr)
+{
+	buffer_remove(vio, addr);
+}
+
+void
+shvio_invalidate_buffers(SHVIO *vio)
+{
+	free(vio->buffers);
+	vio->buffers = NULL;
+	vio->nr_buffers = 0;
+	vio->max_buffers = 0;
+}
+
+/* Lines of each plane start on this boundary */
+#define SURFACE_ALIGN	32
+
+static int pitch_aligned(ren_vid_format_t format, int pitch, int flags)
+{
+	if (size_y(format, pitch, 0) % SURFACE_ALIGN)
+		return 0;
+	if (chroma_bpitch(format, pitch) % SURFACE_ALIGN)
+		return 0;
+	if ((flags & SHVIO_SURFACE_ALPHA) && (pitch % SURFACE_ALIGN))
+		return 0;
+	return 1;
+}
+
+static int surface_pitch(ren_vid_format_t format, int w, int flags)
+{
+	const struct format_info *fmt = &fmts[format];
+	int inc = fmt->c_ss_horz;
+	int pitch = (w + inc - 1) / inc * inc;
+
+	if (flags & SHVIO_SURFACE_POW2_PITCH) {
+		size_t min = size_y(format, pitch, 0);
+		size_t bpitch;
+
+		for (bpitch = SURFACE_ALIGN; bpitch < (1 << 20); bpitch *= 2) {
+			if (bpitch < min || bpitch % fmt->y_bpp)
+				continue;
+			pitch = bpitch / fmt->y_bpp;
+			if (pitch_aligned(format, pitch, flags))
+				return pitch;
+		}
+		return -1;
+	}
+
+	while (!pitch_aligned(format, pitch, flags))
+		pitch += inc;
+
+	return pitch;
+}
+
+/* Total size of a surface from shvio_surface_alloc */
+static size_t surface_size(const struct ren_vid_surface *s)
+{
+	const struct format_info *fmt = &fmts[s->format];
+	int h = (s->h + fmt->c_ss_vert - 1) / fmt->c_ss_vert * fmt->c_ss_vert;
+	size_t len = (size_t)s->bpitchy * h;
+
+	if (s->pc)
+		len += (size_t)s->bpitchc * (h / fmt->c_ss_vert);
+	if (s->pc2)
+		len += (size_t)s->bpitchc * (h / fmt->c_ss_vert);
+	if (s->pa)
+		len += (size_t)s->bpitcha * h;
+
+	return len;
+}
+
+int
+shvio_surface_alloc(
+	SHVIO *vio,
+	struct ren_vid_surface *surface,
+	ren_vid_format_t format,
+	int w,
+	int h,
+	int flags)
+{
+	const struct format_info *fmt;
+	struct ren_vid_surface s;
+	size_t len, plane_y, plane_c;
+	int lines, pitch;
+
+	if (!vio || !surface || w <= 0 || h <= 0 ||
+	    format <= REN_UNKNOWN || format >= sizeof(fmts) / sizeof(fmts[0])) {
+		debug_info("ERR: Invalid input - need format and size");
+		return -1;
+	}
+
+	fmt = &fmts[format];
+	pitch = surface_pitch(format, w, flags);
+	if (pitch < 0) {
+		debug_info("ERR: No power of two pitch for format");
+		return -1;
+	}
+
+	memset(&s, 0, sizeof(s));
+	s.format = format;
+	s.w = w;
+	s.h = h;
+	s.pitch = pitch;
+	s.bpitchy = size_y(format, pitch, 0);
+	s.bpitchc = chroma_bpitch(format, pitch);
+	s.bpitcha = (flags & SHVIO_SURFACE_ALPHA) ? pitch : 0;
+
+	/* chroma planes need whole lines for odd heights */
+	lines = (h + fmt->c_ss_vert - 1) / fmt->c_ss_vert;
+	plane_y = (size_t)s.bpitchy * lines * fmt->c_ss_vert;
+	plane_c = (size_t)s.bpitchc * lines;
+
+	len = plane_y;
+	len += is_ycbcr_planar(format) ? plane_c * 2 : plane_c;
+	if (flags & SHVIO_SURFACE_ALPHA)
+		len += (size_t)s.bpitcha * lines * fmt->c_ss_vert;
+
+	s.py = uiomux_malloc(vio->uiomux, vio->uiores, len, SURFACE_ALIGN);
+	if (!s.py) {
+		debug_info("ERR: Unable to allocate surface");
+		return -1;
+	}
+
+	if (is_ycbcr_planar(format)) {
+		s.pc2 = s.py + plane_y;
+		s.pc = s.pc2 + plane_c;
+		plane_c *= 2;
+	} else if (plane_c) {
+		s.pc = s.py + plane_y;
+	}
+	if (flags & SHVIO_SURFACE_ALPHA)
+		s.pa = s.py + plane_y + plane_c;
+
+	if (shvio_register_buffer(vio, s.py, len, 0) < 0) {
+		uiomux_free(vio->uiomux, vio->uiores, s.py, len);
+		return -1;
+	}
+
+	*surface = s;
+
+	return 0;
+}
+
+void
+shvio_surface_free(
+	SHVIO *vio,
+	struct ren_vid_surface *surface)
+{
+	if (!surface || !surface->py)
+		return;
+
+	shvio_unregister_buffer(vio, surface->py);
+	uiomux_free(vio->uiomux, vio->uiores, surface->py, surface_size(surface));
+	memset(surface, 0, sizeof(*surface));
+}
+
+/* Cache maintenance of a virtual address range */
+static int cache_sync(void *p, size_t len, int for_device)
+{
+#if defined(__sh__) && defined(__NR_cacheflush)
+	int op = for_device ? CACHEFLUSH_D_WB : CACHEFLUSH_D_PURGE;
+
+	return syscall(__NR_cacheflush, p, len, op) < 0 ? -1 : 0;
+#else
+	debug_info("ERR: No cache maintenance on this platform");
+	return -1;
+#endif
+}
+
+/* Cache maintenance of lines y to y + h - 1 of a plane, from byte x for
+   len bytes */
+static int plane_sync(void *p, int bpitch, int x, int y, int len, int h,
+		      int for_device)
+{
+	if (!p || h <= 0 || len <= 0)
+		return 0;
+
+	return cache_sync(p + (size_t)y * bpitch + x,
+			  (size_t)(h - 1) * bpitch + len, for_device);
+}
+
+static int
+surface_sync(
+	SHVIO *vio,
+	const struct ren_vid_surface *s,
+	const struct ren_vid_rect *rect,
+	int for_device)
+{
+	const struct format_info *fmt;
+	struct ren_vid_rect r;
+	int ret, cx, cw, cy, ch;
+
+	if (!vio || !s || !s->py) {
+		debug_info("ERR: Invalid input - need surface");
+		return -1;
+	}
+
+	ret = dmabuf_sync(vio, s->py, for_device);
+	if (ret <= 0)
+		return ret;
+
+	if (rect) {
+		r = *rect;
+	} else {
+		r.x = r.y = 0;
+		r.w = s->w;
+		r.h = s->h;
+	}
+
+	/* chroma area, widened to whole sub-sampled pixels */
+	fmt = &fmts[s->format];
+	cx = r.x / fmt->c_ss_horz * fmt->c_ss_horz;
+	cw = (r.x + r.w + fmt->c_ss_horz - 1) / fmt->c_ss_horz * fmt->c_ss_horz - cx;
+	cy = r.y / fmt->c_ss_vert;
+	ch = (r.y + r.h + fmt->c_ss_vert - 1) / fmt->c_ss_vert - cy;
+
+	ret = plane_sync(s->py, bpitch_y(s), size_y(s->format, r.x, 0), r.y,
+			 size_y(s->format, r.w, 0), r.h, for_device);
+	ret |= plane_sync(s->pc, bpitch_c(s), chroma_bpitch(s->format, cx), cy,
+			  chroma_bpitch(s->format, cw), ch, for_device);
+	if (is_ycbcr_planar(s->format))
+		ret |= plane_sync(s->pc2, bpitch_c(s), chroma_bpitch(s->format, cx), cy,
+				  chroma_bpitch(s->format, cw), ch, for_device);
+	ret |= plane_sync(s->pa, bpitch_a(s), r.x, r.y, r.w, r.h, for_device);
+
+	return ret;
+}
+
+int
+shvio_surface_sync_for_device(
+	SHVIO *vio,
+	const struct ren_vid_surface *surface,
+	const struct ren_vid_rect *rect)
+{
+	return surface_sync(vio, surface, rect, 1);
+}
+
+int
+shvio_surface_sync_for_cpu(
+	SHVIO *vio,
+	const struct ren_vid_surface *surface,
+	const struct ren_vid_rect *rect)
+{
+	return surface_sync(vio, surface, rect, 0);
+}
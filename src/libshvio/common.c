@@ -33,6 +33,7 @@
 
 #include <uiomux/uiomux.h>
 #include "common.h"
+#include "probes.h"
 
 struct shvio_operations veu_ops;
 struct shvio_operations vio6_ops;
@@ -46,6 +47,8 @@ SHVIO *shvio_open_named(const char *name)
 	if (!vio)
 		goto err;
 
+	strncpy(vio->dev_name, name ? name : "VEU", sizeof(vio->dev_name) - 1);
+
 	if (!name) {
 		vio->uiomux = uiomux_open();
 		vio->uiores = UIOMUX_SH_VEU;
@@ -64,6 +67,9 @@ SHVIO *shvio_open_named(const char *name)
 	if (!vio->uiomux)
 		goto err;
 
+	/* the VEU always waited for the device, VIO6 never for its entities */
+	vio->timeout_ms = vio->ops.shares_hw ? 0 : -1;
+
 	ret = uiomux_get_mmio (vio->uiomux, vio->uiores,
 		&vio->uio_mmio.address,
 		&vio->uio_mmio.size,
@@ -71,6 +77,8 @@ SHVIO *shvio_open_named(const char *name)
 	if (!ret)
 		goto err;
 
+	trace_open(vio);
+
 	return vio;
 
 err:
@@ -87,6 +95,11 @@ SHVIO *shvio_open(void)
 void shvio_close(SHVIO *vio)
 {
 	if (vio) {
+		wake_probe_stop(vio);
+		trace_close(vio);
+		dmabuf_release_all(vio);
+		shvio_invalidate_buffers(vio);
+		release_bounce(vio);
 		if (vio->uiomux)
 			uiomux_close(vio->uiomux);
 		free(vio);
@@ -135,84 +148,204 @@ err:
 	return -1;
 }
 
-static void copy_plane(void *dst, void *src, int bpp, int h, int len, int dst_bpitch, int src_bpitch)
+static void dbg(const char *str1, int l, const char *str2, const struct ren_vid_surface *s)
 {
-	int y;
-	if (src && dst != src) {
-		printf("MEMCPY a surface\n");
-		for (y=0; y<h; y++) {
-			memcpy(dst, src, len * bpp);
-			src += src_bpitch;
-			dst += dst_bpitch;
-		}
-	}
+#ifdef DEBUG
+	fprintf(stderr, "%s:%d: %s: (%dx%d) pitch=%d py=%p, pc=%p, pa=%p, bpitchy=%d, bpitchc=%d, bpitcha=%d\n", str1, l, str2, s->w, s->h, s->pitch, s->py, s->pc, s->pa, s->bpitchy, s->bpitchc, s->bpitcha);
+#endif
 }
 
-/* Copy active surface contents - assumes output is big enough */
-static void copy_surface(
-	struct ren_vid_surface *out,
-	const struct ren_vid_surface *in)
+/* Forget the progress of the previous operation */
+static void reset_progress(SHVIO *vio)
 {
-	const struct format_info *fmt = &fmts[in->format];
-	int src_bpitch, dst_bpitch;
+	vio->bundle_lines = 0;
+	vio->src_lines_done = 0;
+	vio->dst_lines_ready = 0;
+	vio->dst_lines_done = 0;
+}
 
-	src_bpitch = (in->bpitchy != 0) ? in->bpitchy : in->pitch * fmt->y_bpp;
-	dst_bpitch = (out->bpitchy != 0) ? out->bpitchy : out->pitch * fmt->y_bpp;
-	copy_plane(out->py, in->py, fmt->y_bpp, in->h, in->w, dst_bpitch, src_bpitch);
+/* Add a time to the timings of a phase */
+static void stats_add(SHVIO *vio, int phase, unsigned long us)
+{
+	struct shvio_phase_stats *p = &vio->stats.phase[phase];
+	int bucket = 0;
 
-	src_bpitch = (in->bpitchc != 0) ? in->bpitchc :
-		in->pitch / fmt->c_ss_horz * fmt->c_bpp;
-	dst_bpitch = (out->bpitchc != 0) ? out->bpitchc :
-		out->pitch / fmt->c_ss_horz * fmt->c_bpp;
-	copy_plane(out->pc, in->pc, fmt->c_bpp,
-		in->h/fmt->c_ss_vert,
-		in->w/fmt->c_ss_horz,
-		src_bpitch,
-		dst_bpitch);
+	p->count++;
+	p->total_us += us;
+	if (us > p->max_us)
+		p->max_us = us;
 
-	src_bpitch = (in->bpitcha != 0) ? in->bpitcha : in->pitch;
-	dst_bpitch = (out->bpitcha != 0) ? out->bpitcha : out->pitch;
-	copy_plane(out->pa, in->pa, 1, in->h, in->w, dst_bpitch, src_bpitch);
+	while (us && bucket < SHVIO_HIST_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+	p->hist[bucket]++;
 }
 
-/* Check/create surface that can be accessed by the hardware */
-static int get_hw_surface(
-	UIOMux * uiomux,
-	uiomux_resource_t resource,
-	struct ren_vid_surface *out,
-	const struct ren_vid_surface *in)
+/* Add the time since start to the timings of a phase, and return it */
+unsigned long stats_time(SHVIO *vio, int phase, const struct timespec *start)
 {
-	int alloc = 0;
+	unsigned long us;
 
-	if (in == NULL || out == NULL)
+	if (!vio->timing)
 		return 0;
 
-	*out = *in;
-	if (in->py) alloc |= !uiomux_all_virt_to_phys(in->py);
-	if (in->pc) alloc |= !uiomux_all_virt_to_phys(in->pc);
+	us = elapsed_us(start);
+	stats_add(vio, phase, us);
+	return us;
+}
 
-	if (alloc) {
-		/* One of the supplied buffers is not usable by the hardware! */
-		size_t len = size_y(in->format, in->h * in->w, 0);
-		if (in->pc) len += size_c(in->format, in->h * in->w, 0);
+/* Time the programming of the hardware since start, less any wait for
+   the hardware on the way, which the backend timed as locking */
+static void stats_program(SHVIO *vio, const struct timespec *start)
+{
+	unsigned long us;
 
-		out->py = uiomux_malloc(uiomux, resource, len, 32);
-		if (!out->py)
-			return -1;
+	if (!vio->timing)
+		return;
 
-		if (in->pc) {
-			out->pc = out->py + size_y(in->format, in->h * in->w, 0);
-		}
+	us = elapsed_us(start);
+	us = (us > vio->lock_us) ? us - vio->lock_us : 0;
+	stats_add(vio, SHVIO_PHASE_PROGRAM, us);
+}
+
+/* Take the whole device, unless the backend arbitrates its entities itself,
+   in which case it times the wait for them while programming. The device
+   is queued for by priority like VIO6 entities, then locked against users
+   of UIOMux other than libshvio. */
+static int hw_lock(SHVIO *vio)
+{
+	struct timespec start;
+	int ret = 0;
+
+	vio->lock_us = 0;
+	if (!vio->ops.shares_hw) {
+		stats_clock(vio, &start);
+		ret = device_lock(vio);
+		if (ret == 0)
+			uiomux_lock(vio->uiomux, vio->uiores);
+		stats_time(vio, SHVIO_PHASE_LOCK, &start);
+		if (ret < 0)
+			return -1;
 	}
+	PROBE2(lock, vio);
 
 	return 0;
 }
 
-static void dbg(const char *str1, int l, const char *str2, const struct ren_vid_surface *s)
+static void hw_unlock(SHVIO *vio)
 {
-#ifdef DEBUG
-	fprintf(stderr, "%s:%d: %s: (%dx%d) pitch=%d py=%p, pc=%p, pa=%p, bpitchy=%d, bpitchc=%d, bpitcha=%d\n", str1, l, str2, s->w, s->h, s->pitch, s->py, s->pc, s->pa, s->bpitchy, s->bpitchc, s->bpitcha);
-#endif
+	if (!vio->ops.shares_hw) {
+		uiomux_unlock(vio->uiomux, vio->uiores);
+		device_unlock(vio);
+	}
+	PROBE2(unlock, vio);
+}
+
+/* An operation starts, or the first stripe of a split up one */
+static void job_begin(SHVIO *vio)
+{
+	static unsigned long last_job_id;
+
+	if (vio->in_stripes)
+		return;
+
+	vio->job_id = __sync_add_and_fetch(&last_job_id, 1);
+	vio->op_sleeps = 0;
+	clock_gettime(CLOCK_MONOTONIC, &vio->job_start);
+}
+
+/* An operation was abandoned after an error */
+static void job_fail(SHVIO *vio)
+{
+	if (vio->in_stripes)
+		return;
+
+	vio->stats.failures++;
+}
+
+/* An operation is complete, check it against its deadline */
+static void job_end(SHVIO *vio)
+{
+	unsigned long elapsed, late;
+
+	if (vio->in_stripes)
+		return;
+
+	vio->stats.ops++;
+	vio->stats.sleeps_per_op[(vio->op_sleeps < SHVIO_SLEEP_BUCKETS) ?
+				 vio->op_sleeps : SHVIO_SLEEP_BUCKETS - 1]++;
+	if (vio->deadline_us <= 0)
+		return;
+
+	elapsed = elapsed_us(&vio->job_start);
+	if (elapsed <= (unsigned long)vio->deadline_us)
+		return;
+
+	late = elapsed - vio->deadline_us;
+	debug_info("LOG: deadline missed");
+	vio->stats.deadline_misses++;
+	if (late > vio->stats.deadline_max_late_us)
+		vio->stats.deadline_max_late_us = late;
+}
+
+/* Finish the destination lines written by the hardware since the last call:
+   apply the colour matrix and copy them back from the bounce buffer */
+void finish_dst_lines(SHVIO *vio)
+{
+	struct ren_vid_surface hw, user;
+	struct ren_vid_rect sel;
+	struct timespec start;
+	int end = vio->dst_lines_ready;
+
+	/* keep chroma lines whole until the last stripe */
+	if (end < vio->dst_hw.h)
+		end &= ~(vert_increment(vio->dst_hw.format) - 1);
+	if (end <= vio->dst_lines_done)
+		return;
+
+	PROBE4(copy_back, vio, vio->dst_lines_done, end - vio->dst_lines_done);
+	stats_clock(vio, &start);
+	sel.x = 0;
+	sel.y = vio->dst_lines_done;
+	sel.w = vio->dst_hw.w;
+	sel.h = end - vio->dst_lines_done;
+
+	get_sel_surface(&hw, &vio->dst_hw, &sel);
+	hw.h = sel.h;
+	if (vio->has_matrix && !vio->matrix_hw)
+		matrix_apply(&vio->matrix, &hw);
+
+	if (vio->dst_hw.py != vio->dst_user.py) {
+		get_sel_surface(&user, &vio->dst_user, &sel);
+		user.h = sel.h;
+		copy_surface(&user, &hw);
+	}
+
+	vio->dst_lines_done = end;
+	stats_time(vio, SHVIO_PHASE_COPY_OUT, &start);
+}
+
+/* Decide how the colour correction matrix is applied to the next operation */
+static int
+setup_matrix(
+	SHVIO *vio,
+	const struct ren_vid_surface *src,
+	const struct ren_vid_surface *dst)
+{
+	vio->matrix_hw = 0;
+	if (!vio->has_matrix)
+		return 0;
+
+	if (src && vio->ops.fuse_matrix)
+		vio->matrix_hw = vio->ops.fuse_matrix(vio, src, dst);
+
+	if (!vio->matrix_hw && !matrix_supported(dst->format)) {
+		debug_info("ERR: Colour matrix unsupported for dest format");
+		return -1;
+	}
+
+	return 0;
 }
 
 int
@@ -226,6 +359,7 @@ shvio_setup(
 	struct ren_vid_surface local_dst;
 	struct ren_vid_surface *src = &local_src;
 	struct ren_vid_surface *dst = &local_dst;
+	struct timespec start;
 
 	dbg(__func__, __LINE__, "src_user", src_surface);
 	dbg(__func__, __LINE__, "dst_user", dst_surface);
@@ -235,19 +369,29 @@ shvio_setup(
 		return -1;
 	}
 
+	if (setup_matrix(vio, src_surface, dst_surface) < 0)
+		return -1;
+	reset_progress(vio);
+
 	/* source - use a buffer the hardware can access */
-	if (get_hw_surface(vio->uiomux, vio->uiores, src, src_surface) < 0) {
+	stats_clock(vio, &start);
+	if (get_hw_surface(vio, BOUNCE_SRC, src, src_surface) < 0) {
 		debug_info("ERR: src is not accessible by hardware");
 		return -1;
 	}
+	stats_time(vio, SHVIO_PHASE_BOUNCE_ALLOC, &start);
 
+	stats_clock(vio, &start);
 	copy_surface(src, src_surface);
+	stats_time(vio, SHVIO_PHASE_COPY_IN, &start);
 
 	/* destination - use a buffer the hardware can access */
-	if (get_hw_surface(vio->uiomux, vio->uiores, dst, dst_surface) < 0) {
+	stats_clock(vio, &start);
+	if (get_hw_surface(vio, BOUNCE_DST, dst, dst_surface) < 0) {
 		debug_info("ERR: dest is not accessible by hardware");
-		goto fail_get_hw_surface_dst;
+		return -1;
 	}
+	stats_time(vio, SHVIO_PHASE_BOUNCE_ALLOC, &start);
 
 	/* Keep track of the requested surfaces */
 	vio->src_user = *src_surface;
@@ -257,27 +401,23 @@ shvio_setup(
 	vio->src_hw = local_src;
 	vio->dst_hw = local_dst;
 
-	uiomux_lock (vio->uiomux, vio->uiores);
+	job_begin(vio);
+	PROBE8(setup, vio, src->format, src->w, src->h,
+	       dst->format, dst->w, dst->h);
+	if (hw_lock(vio) < 0)
+		return -1;
 
-	if (vio->ops.setup(vio, src, dst, filter_control) < 0)
+	stats_clock(vio, &start);
+	if (vio->ops.setup(vio, src, dst, filter_control) < 0) {
+		trace_error(vio);
 		goto fail_setup;
+	}
+	stats_program(vio, &start);
 
 	return 0;
 
 fail_setup:
-	uiomux_unlock(vio->uiomux, vio->uiores);
-
-	if (vio->dst_hw.py != dst_surface->py) {
-		size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
-	}
-fail_get_hw_surface_dst:
-	if (vio->src_hw.py != src_surface->py) {
-		size_t len = size_y(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		len += size_c(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->src_hw.py, len);
-	}
+	hw_unlock(vio);
 
 	return -1;
 }
@@ -328,9 +468,85 @@ shvio_set_color_conversion(
 	vio->full_range = full_range;
 }
 
+void
+shvio_set_color_matrix(
+	SHVIO *vio,
+	const struct shvio_color_matrix *matrix)
+{
+	if (matrix) {
+		vio->matrix = *matrix;
+		vio->has_matrix = 1;
+	} else {
+		vio->has_matrix = 0;
+	}
+}
+
+void
+shvio_set_priority(
+	SHVIO *vio,
+	int priority)
+{
+	vio->priority = priority;
+}
+
+void
+shvio_set_timeout(
+	SHVIO *vio,
+	int timeout_ms)
+{
+	vio->timeout_ms = timeout_ms;
+}
+
+void
+shvio_set_deadline(
+	SHVIO *vio,
+	long deadline_us)
+{
+	vio->deadline_us = deadline_us;
+}
+
+void
+shvio_set_stripe(
+	SHVIO *vio,
+	int stripe_lines)
+{
+	vio->stripe_lines = (stripe_lines > 0) ? stripe_lines : 0;
+}
+
+void
+shvio_enable_timing(
+	SHVIO *vio,
+	int enable)
+{
+	if ((enable & SHVIO_TIMING_WAKE) && wake_probe_start(vio) < 0)
+		enable = SHVIO_TIMING_PHASES;
+	else if (!(enable & SHVIO_TIMING_WAKE))
+		wake_probe_stop(vio);
+
+	vio->timing = enable;
+}
+
+void
+shvio_get_stats(
+	SHVIO *vio,
+	struct shvio_stats *stats)
+{
+	*stats = vio->stats;
+}
+
+void
+shvio_reset_stats(SHVIO *vio)
+{
+	memset(&vio->stats, 0, sizeof(vio->stats));
+}
+
 void
 shvio_start(SHVIO *vio)
 {
+	vio->bundle_lines = vio->src_hw.h;
+	stats_clock(vio, &vio->hw_start);
+	PROBE3(start, vio, vio->bundle_lines);
+	wake_arm(vio);
 	vio->ops.start(vio);
 }
 
@@ -340,13 +556,29 @@ shvio_has_bundle(SHVIO *vio)
 	return vio->ops.start_bundle ? 1 : 0;
 }
 
+int
+shvio_format_supported(
+	SHVIO *vio,
+	ren_vid_format_t format)
+{
+	return vio->ops.format_supported(format);
+}
+
 void
 shvio_start_bundle(
 	SHVIO *vio,
 	int bundle_lines)
 {
-	if (vio->ops.start_bundle)
+	if (vio->ops.start_bundle) {
+		vio->bundle_lines = bundle_lines;
+		stats_clock(vio, &vio->hw_start);
+		PROBE3(start, vio, bundle_lines);
+		wake_arm(vio);
 		vio->ops.start_bundle(vio, bundle_lines);
+
+		/* finish the previous stripe while the hardware works on this one */
+		finish_dst_lines(vio);
+	}
 }
 
 int
@@ -354,31 +586,117 @@ shvio_wait(SHVIO *vio)
 {
 	int complete = 0;
 
-	uiomux_sleep(vio->uiomux, vio->uiores);
-
+	/* the backend sleeps until its status says the hardware is done */
 	complete = vio->ops.wait(vio);
-
-	if (complete) {
+	wake_disarm(vio);
+	stats_time(vio, SHVIO_PHASE_HW, &vio->hw_start);
+
+	if (complete < 0) {
+		trace_error(vio);
+		hw_unlock(vio);
+		job_fail(vio);
+	} else if (complete) {
 		dbg(__func__, __LINE__, "src_hw", &vio->src_hw);
 		dbg(__func__, __LINE__, "dst_hw", &vio->dst_hw);
-		copy_surface(&vio->dst_user, &vio->dst_hw);
+		vio->dst_lines_ready = vio->dst_hw.h;
+		finish_dst_lines(vio);
+
+		hw_unlock(vio);
+		job_end(vio);
+	} else if (vio->src_hw.h > 0) {
+		/* A stripe is done, it is finished by the next shvio_start_bundle */
+		vio->src_lines_done += vio->bundle_lines;
+		vio->dst_lines_ready = dst_lines_for(vio, vio->src_lines_done);
+	}
 
-		/* free locally allocated surfaces */
-		if (vio->src_hw.py != vio->src_user.py) {
-			size_t len = size_y(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-			len += size_c(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-			uiomux_free(vio->uiomux, vio->uiores, vio->src_hw.py, len);
-		}
-		if (vio->dst_hw.py != vio->dst_user.py) {
-			size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-			len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-			uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
+	return complete;
+}
+
+/* Source line of a destination line, rounded down or up to whole chroma */
+static int src_line_for(
+	const struct ren_vid_surface *src,
+	const struct ren_vid_surface *dst,
+	int dst_line,
+	int round_up)
+{
+	int inc = vert_increment(src->format);
+	long y = (long)dst_line * src->h;
+
+	y = (y + (round_up ? dst->h - 1 : 0)) / dst->h;
+	if (round_up)
+		y += inc - 1;
+	y &= ~(inc - 1);
+
+	return (y > src->h) ? src->h : y;
+}
+
+/* Resize a stripe at a time, giving up the hardware in between */
+static int
+resize_striped(
+	SHVIO *vio,
+	const struct ren_vid_surface *src_surface,
+	const struct ren_vid_surface *dst_surface)
+{
+	struct ren_vid_surface src, dst;
+	struct ren_vid_rect sel;
+	int timeout_ms = vio->timeout_ms;
+	int step = vio->stripe_lines;
+	int dy0, dy1, sy0, sy1;
+	int started = 0;
+	int ret = 0;
+
+	step &= ~(vert_increment(dst_surface->format) - 1);
+	if (step <= 0)
+		step = vert_increment(dst_surface->format);
+
+	job_begin(vio);
+	vio->in_stripes = 1;
+
+	for (dy0 = 0; dy0 < dst_surface->h; dy0 = dy1) {
+		dy1 = dy0 + step;
+		if (dy1 > dst_surface->h)
+			dy1 = dst_surface->h;
+
+		sy0 = src_line_for(src_surface, dst_surface, dy0, 0);
+		sy1 = src_line_for(src_surface, dst_surface, dy1, 1);
+		if (dy1 == dst_surface->h)
+			sy1 = src_surface->h;
+
+		sel.x = 0;
+		sel.y = sy0;
+		sel.w = src_surface->w;
+		sel.h = sy1 - sy0;
+		get_sel_surface(&src, src_surface, &sel);
+		src.h = sel.h;
+
+		sel.y = dy0;
+		sel.w = dst_surface->w;
+		sel.h = dy1 - dy0;
+		get_sel_surface(&dst, dst_surface, &sel);
+		dst.h = sel.h;
+
+		ret = shvio_setup(vio, &src, &dst, SHVIO_NO_ROT);
+		if (ret < 0)
+			break;
+		shvio_start(vio);
+		started = 1;
+		if (shvio_wait(vio) < 0) {
+			ret = -1;
+			break;
 		}
 
-		uiomux_unlock(vio->uiomux, vio->uiores);
+		/* don't give up on a half done surface */
+		vio->timeout_ms = -1;
 	}
 
-	return complete;
+	vio->timeout_ms = timeout_ms;
+	vio->in_stripes = 0;
+	if (ret == 0)
+		job_end(vio);
+	else if (started)
+		job_fail(vio);	/* the destination is half done */
+
+	return ret;
 }
 
 int
@@ -389,11 +707,16 @@ shvio_resize(
 {
 	int ret;
 
+	if (vio && src_surface && dst_surface && vio->stripe_lines &&
+	    vio->stripe_lines < dst_surface->h)
+		return resize_striped(vio, src_surface, dst_surface);
+
 	ret = shvio_setup(vio, src_surface, dst_surface, SHVIO_NO_ROT);
 
 	if (ret == 0) {
 		shvio_start(vio);
-		shvio_wait(vio);
+		if (shvio_wait(vio) < 0)
+			ret = -1;
 	}
 
 	return ret;
@@ -412,7 +735,8 @@ shvio_rotate(
 
 	if (ret == 0) {
 		shvio_start(vio);
-		shvio_wait(vio);
+		if (shvio_wait(vio) < 0)
+			ret = -1;
 	}
 
 	return ret;
@@ -426,6 +750,7 @@ shvio_fill(
 {
 	struct ren_vid_surface local_dst;
 	struct ren_vid_surface *dst = &local_dst;
+	struct timespec start;
 
 	dbg(__func__, __LINE__, "dst_user", dst_surface);
 
@@ -439,11 +764,17 @@ shvio_fill(
 		return -1;
 	}
 
+	if (setup_matrix(vio, NULL, dst_surface) < 0)
+		return -1;
+	reset_progress(vio);
+
 	/* destination - use a buffer the hardware can access */
-	if (get_hw_surface(vio->uiomux, vio->uiores, dst, dst_surface) < 0) {
+	stats_clock(vio, &start);
+	if (get_hw_surface(vio, BOUNCE_DST, dst, dst_surface) < 0) {
 		debug_info("ERR: dest is not accessible by hardware");
-		goto fail_get_hw_surface_dst;
+		return -1;
 	}
+	stats_time(vio, SHVIO_PHASE_BOUNCE_ALLOC, &start);
 
 	/* Keep track of the requested surfaces */
 	memset(&vio->src_user, 0, sizeof(vio->src_user));
@@ -453,25 +784,26 @@ shvio_fill(
 	memset(&vio->src_hw, 0, sizeof(vio->src_hw));
 	vio->dst_hw = local_dst;
 
-	uiomux_lock (vio->uiomux, vio->uiores);
+	job_begin(vio);
+	PROBE8(setup, vio, REN_UNKNOWN, 0, 0, dst->format, dst->w, dst->h);
+	if (hw_lock(vio) < 0)
+		return -1;
 
-	if (vio->ops.fill(vio, dst, argb) < 0)
+	stats_clock(vio, &start);
+	if (vio->ops.fill(vio, dst, argb) < 0) {
+		trace_error(vio);
 		goto fail_fill;
+	}
+	stats_program(vio, &start);
 
 	shvio_start(vio);
-	shvio_wait(vio);
+	if (shvio_wait(vio) < 0)
+		return -1;
 
 	return 0;
 
 fail_fill:
-	uiomux_unlock(vio->uiomux, vio->uiores);
-
-	if (vio->dst_hw.py != dst_surface->py) {
-		size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
-	}
-fail_get_hw_surface_dst:
+	hw_unlock(vio);
 
 	return -1;
 }
@@ -483,15 +815,43 @@ shvio_setup_blend(
 	int src_count,
 	const struct ren_vid_surface *dst)
 {
-	uiomux_lock (vio->uiomux, vio->uiores);
+	struct timespec start;
 
-	if (vio->ops.setup_blend(vio, virt, src_list, src_count, dst) < 0)
+	if (!vio || !src_list || src_count < 1 || !dst) {
+		debug_info("ERR: Invalid input - need src and dest");
+		return -1;
+	}
+
+	if (!vio->ops.setup_blend) {
+		debug_info("ERR: Unsupported by HW");
+		return -1;
+	}
+
+	if (setup_matrix(vio, NULL, dst) < 0)
+		return -1;
+	reset_progress(vio);
+
+	/* Blend surfaces are used as is, so there is nothing to copy back */
+	vio->src_user = vio->src_hw = *src_list[0];
+	vio->dst_user = vio->dst_hw = *dst;
+
+	job_begin(vio);
+	PROBE8(setup, vio, src_list[0]->format, src_list[0]->w, src_list[0]->h,
+	       dst->format, dst->w, dst->h);
+	if (hw_lock(vio) < 0)
+		return -1;
+
+	stats_clock(vio, &start);
+	if (vio->ops.setup_blend(vio, virt, src_list, src_count, dst) < 0) {
+		trace_error(vio);
 		goto fail_setup_blend;
+	}
+	stats_program(vio, &start);
 
 	return 0;
 
 fail_setup_blend:
-	uiomux_unlock(vio->uiomux, vio->uiores);
+	hw_unlock(vio);
 
 	return -1;
 }
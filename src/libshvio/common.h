@@ -26,6 +26,7 @@
 #define __API_H__
 
 #include <pthread.h>
+#include <time.h>
 #include <uiomux/uiomux.h>
 #include "shvio/shvio.h"
 
@@ -60,11 +61,17 @@ struct shvio_operations {
 	void (*start)(SHVIO *vio);
 	void (*start_bundle)(SHVIO *vio, int bundle_lines);
 	int (*wait)(SHVIO *vio);
+	int (*done_reg)(SHVIO *vio, uint32_t *mask);	/* status of the running job */
 	int (*setup_blend)(SHVIO *vio,
 			   const struct ren_vid_rect *virt,
 			   const struct ren_vid_surface *const *src_list,
 			   int src_count,
 			   const struct ren_vid_surface *dst_surface);
+	int (*fuse_matrix)(SHVIO *vio, const struct ren_vid_surface *src_surface,
+			   const struct ren_vid_surface *dst_surface);
+	int (*format_supported)(ren_vid_format_t format);
+	void (*reg_name)(int reg_nr, char *buf, size_t len);
+	int shares_hw;	/* jobs take entities, not the whole device */
 };
 
 typedef enum {
@@ -86,7 +93,6 @@ struct shvio_entity {
 	int			dpr_ctrl;
 	int			dpr_shift;
 	shvio_func_t		funcs;
-	pthread_mutex_t		lock;
 
 	struct shvio_entity *	pad_in[N_INPADS];
 	struct shvio_entity *	pad_out;
@@ -94,9 +100,20 @@ struct shvio_entity {
 	struct shvio_entity *	list_next;
 };
 
+/* Bounce buffer slots */
+#define BOUNCE_SRC	0
+#define BOUNCE_DST	1
+#define N_BOUNCE	2
+
+struct shvio_bounce {
+	void *p;
+	size_t size;
+};
+
 struct SHVIO {
 	UIOMux *uiomux;
 	uiomux_resource_t uiores;
+	char dev_name[16];
 	struct uio_map uio_mmio;
 	struct ren_vid_surface src_user;
 	struct ren_vid_surface src_hw;
@@ -106,10 +123,187 @@ struct SHVIO {
 	int full_range;
 	int bundle_processing_lines;
 	int bundle_remaining_lines;
+	int bundle_lines;	/* source lines of the running stripe */
+	int src_lines_done;	/* source lines of completed stripes */
+	int dst_lines_ready;	/* destination lines written by the hardware */
+	int dst_lines_done;	/* destination lines copied back */
+	uint32_t dst_addr[3];	/* destination addresses of the running stripe */
+	uint32_t next_dst_addr[3];	/* destination addresses of the next stripe */
+	struct shvio_color_matrix matrix;
+	int has_matrix;
+	int matrix_hw;		/* matrix is applied by the hardware */
+	struct shvio_dmabuf *dmabufs;
+	struct shvio_buffer *buffers;
+	int nr_buffers;
+	int max_buffers;
+	struct shvio_bounce bounce[N_BOUNCE];
+	int priority;
+	int timeout_ms;
+	long deadline_us;	/* 0 if operations have no deadline */
+	int stripe_lines;	/* 0 if resizes are not split up */
+	int in_stripes;		/* a split up resize is in progress */
+	unsigned long job_id;	/* current operation, shared by its stripes */
+	struct timespec job_start;
+	struct timespec hw_start;	/* the running stripe was started */
+	int timing;		/* SHVIO_TIMING_* of what is timed */
+	int op_sleeps;		/* sleeps of the current operation */
+	unsigned long lock_us;	/* waited for the hardware while programming */
+	struct wake_probe *wake;	/* watches for the end on the hardware */
+	struct shvio_stats stats;
 
 	struct shvio_operations ops;
 	struct shvio_entity *locked_entities;
 	struct shvio_entity *sink_entity;
+	int device_slot;	/* of the whole device, if not shares_hw */
 };
 
+/* Byte pitch of the chroma plane(s) for a pitch in pixels */
+static inline int chroma_bpitch(ren_vid_format_t format, int pitch)
+{
+	const struct format_info *fmt = &fmts[format];
+	int bpitch = pitch / fmt->c_ss_horz * fmt->c_bpp;
+
+	/* Planar formats split c_bpp across the Cb and Cr planes */
+	return is_ycbcr_planar(format) ? bpitch / 2 : bpitch;
+}
+
+/* Byte pitches of the planes of a surface */
+static inline int bpitch_y(const struct ren_vid_surface *s)
+{
+	return size_y(s->format, s->pitch, s->bpitchy);
+}
+
+static inline int bpitch_c(const struct ren_vid_surface *s)
+{
+	return s->bpitchc ? s->bpitchc : chroma_bpitch(s->format, s->pitch);
+}
+
+static inline int bpitch_a(const struct ren_vid_surface *s)
+{
+	return s->bpitcha ? s->bpitcha : s->pitch;
+}
+
+/* Destination lines written by the hardware for a number of source lines */
+static inline int dst_lines_for(const SHVIO *vio, int src_lines)
+{
+	long lines;
+
+	if (vio->src_hw.h <= 0)
+		return vio->dst_hw.h;
+
+	lines = (long)src_lines * vio->dst_hw.h / vio->src_hw.h;
+	return (lines > vio->dst_hw.h) ? vio->dst_hw.h : lines;
+}
+
+/* Microseconds since a time taken with CLOCK_MONOTONIC */
+static inline unsigned long elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000000 +
+		(now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/* Start timing a phase, if timing is enabled */
+static inline void stats_clock(const SHVIO *vio, struct timespec *start)
+{
+	if (vio->timing)
+		clock_gettime(CLOCK_MONOTONIC, start);
+}
+
+/* Colour conversion parameters between two surfaces. The YCbCr side of the
+   conversion decides, falling back to the per-handle defaults. */
+static inline void get_csc(const SHVIO *vio,
+			   const struct ren_vid_surface *src,
+			   const struct ren_vid_surface *dst,
+			   int *bt709, int *full_range)
+{
+	const struct ren_vid_surface *s = is_ycbcr(src->format) ? src : dst;
+
+	switch (s->flags & COLOR_STD_MASK) {
+	case COLOR_STD_BT601:
+		*bt709 = 0;
+		break;
+	case COLOR_STD_BT709:
+		*bt709 = 1;
+		break;
+	default:
+		*bt709 = vio->bt709;
+		break;
+	}
+
+	switch (s->flags & COLOR_RANGE_MASK) {
+	case COLOR_RANGE_LIMITED:
+		*full_range = 0;
+		break;
+	case COLOR_RANGE_FULL:
+		*full_range = 1;
+		break;
+	default:
+		*full_range = vio->full_range;
+		break;
+	}
+}
+
+/* common.c */
+void finish_dst_lines(SHVIO *vio);
+unsigned long stats_time(SHVIO *vio, int phase, const struct timespec *start);
+
+/* entity.c */
+#define MAX_ENTITIES	32
+
+int entity_alloc(SHVIO *vio, struct shvio_entity *table, int n_table,
+		 const int *funcs, int n, struct shvio_entity **out);
+void entity_free(struct shvio_entity *table, struct shvio_entity *entity);
+int device_lock(SHVIO *vio);
+void device_unlock(SHVIO *vio);
+void entity_hw_lock(void);
+void entity_hw_unlock(void);
+
+/* trace.c */
+extern int trace_enabled;
+
+void trace_record(void *base, int reg, uint32_t value, int write);
+void trace_open(SHVIO *vio);
+void trace_close(SHVIO *vio);
+void trace_error(SHVIO *vio);
+
+static inline void trace_reg(void *base, int reg, uint32_t value, int write)
+{
+	if (trace_enabled)
+		trace_record(base, reg, value, write);
+}
+
+/* wake.c */
+int wake_probe_start(SHVIO *vio);
+void wake_probe_stop(SHVIO *vio);
+void wake_arm(SHVIO *vio);
+void wake_disarm(SHVIO *vio);
+void wait_irq(SHVIO *vio);
+int poll_hw(SHVIO *vio, int (*busy)(SHVIO *vio), unsigned long timeout_us);
+
+/* buffer.c */
+int buffer_add(SHVIO *vio, void *addr, unsigned long phys, size_t size);
+void buffer_remove(SHVIO *vio, void *addr);
+unsigned long vio_virt_to_phys(const SHVIO *vio, const void *addr);
+
+/* dmabuf.c */
+void dmabuf_release_all(SHVIO *vio);
+int dmabuf_sync(SHVIO *vio, const void *addr, int for_device);
+
+/* surface.c */
+void copy_surface(struct ren_vid_surface *out,
+		  const struct ren_vid_surface *in);
+int get_hw_surface(SHVIO *vio, int slot, struct ren_vid_surface *out,
+		   const struct ren_vid_surface *in);
+void release_bounce(SHVIO *vio);
+
+/* matrix.c */
+int matrix_fuse(const struct shvio_color_matrix *m, int bt709, int full_range,
+		uint32_t vmcr[9], uint32_t *vcoffr);
+int matrix_supported(ren_vid_format_t format);
+void matrix_apply(const struct shvio_color_matrix *m,
+		  const struct ren_vid_surface *s);
+
 #endif /* __API_H__ */
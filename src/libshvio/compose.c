@@ -0,0 +1,474 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Dirty-rectangle composition on top of shvio_setup_blend
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+/* Damage beyond this many rectangles is merged into one */
+#define MAX_DAMAGE	16
+
+/* Colour of the BRU virtual input, used when no layer covers an area */
+#define BACKGROUND_ARGB	0xff000000
+
+struct SHVIO_COMPOSER {
+	SHVIO *vio;
+	struct ren_vid_surface dst;
+	struct ren_vid_surface layers[SHVIO_COMPOSER_MAX_LAYERS];
+	int nr_layers;
+	struct ren_vid_rect damage[MAX_DAMAGE];
+	int nr_damage;
+	struct shvio_composer_stats stats;
+};
+
+static int rect_empty(const struct ren_vid_rect *r)
+{
+	return (r->w <= 0 || r->h <= 0);
+}
+
+static int rect_intersect(
+	struct ren_vid_rect *out,
+	const struct ren_vid_rect *a,
+	const struct ren_vid_rect *b)
+{
+	int x0 = (a->x > b->x) ? a->x : b->x;
+	int y0 = (a->y > b->y) ? a->y : b->y;
+	int x1 = (a->x + a->w < b->x + b->w) ? a->x + a->w : b->x + b->w;
+	int y1 = (a->y + a->h < b->y + b->h) ? a->y + a->h : b->y + b->h;
+
+	out->x = x0;
+	out->y = y0;
+	out->w = x1 - x0;
+	out->h = y1 - y0;
+
+	return !rect_empty(out);
+}
+
+static void rect_union(
+	struct ren_vid_rect *out,
+	const struct ren_vid_rect *a,
+	const struct ren_vid_rect *b)
+{
+	int x0 = (a->x < b->x) ? a->x : b->x;
+	int y0 = (a->y < b->y) ? a->y : b->y;
+	int x1 = (a->x + a->w > b->x + b->w) ? a->x + a->w : b->x + b->w;
+	int y1 = (a->y + a->h > b->y + b->h) ? a->y + a->h : b->y + b->h;
+
+	out->x = x0;
+	out->y = y0;
+	out->w = x1 - x0;
+	out->h = y1 - y0;
+}
+
+/* Overlapping or adjacent rectangles are cheaper to blend as one */
+static int rect_touch(const struct ren_vid_rect *a, const struct ren_vid_rect *b)
+{
+	return (a->x <= b->x + b->w && b->x <= a->x + a->w &&
+		a->y <= b->y + b->h && b->y <= a->y + a->h);
+}
+
+/* The part of a layer that is shown, in layer and in output co-ordinates */
+static void layer_area(
+	const struct ren_vid_surface *src,
+	struct ren_vid_rect *sarea,
+	struct ren_vid_rect *darea)
+{
+	const struct ren_vid_rect *bo = &src->blend_out;
+	struct ren_vid_rect whole = { 0, 0, src->w, src->h };
+
+	*sarea = whole;
+	if (src->window.w > 0 && src->window.h > 0)
+		rect_intersect(sarea, &whole, &src->window);
+
+	darea->x = bo->x + sarea->x * bo->w / src->w;
+	darea->y = bo->y + sarea->y * bo->h / src->h;
+	darea->w = sarea->w * bo->w / src->w;
+	darea->h = sarea->h * bo->h / src->h;
+}
+
+static void add_damage(SHVIO_COMPOSER *comp, const struct ren_vid_rect *rect)
+{
+	struct ren_vid_rect whole = { 0, 0, comp->dst.w, comp->dst.h };
+	struct ren_vid_rect r;
+	int x1, y1;
+	int i;
+
+	if (!rect_intersect(&r, rect, &whole))
+		return;
+
+	/* grow to the chroma sub-sampling grid */
+	x1 = (r.x + r.w + 1) & ~1;
+	y1 = (r.y + r.h + 1) & ~1;
+	r.x &= ~1;
+	r.y &= ~1;
+	r.w = ((x1 > whole.w) ? whole.w : x1) - r.x;
+	r.h = ((y1 > whole.h) ? whole.h : y1) - r.y;
+
+	/* merge with any damage it touches, the result may touch others */
+	i = 0;
+	while (i < comp->nr_damage) {
+		if (rect_touch(&r, &comp->damage[i])) {
+			rect_union(&r, &r, &comp->damage[i]);
+			comp->damage[i] = comp->damage[--comp->nr_damage];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+
+	if (comp->nr_damage == MAX_DAMAGE) {
+		for (i = 0; i < comp->nr_damage; i++)
+			rect_union(&r, &r, &comp->damage[i]);
+		comp->nr_damage = 0;
+	}
+
+	comp->damage[comp->nr_damage++] = r;
+}
+
+static void damage_layer(SHVIO_COMPOSER *comp, int layer, const struct ren_vid_rect *rect)
+{
+	const struct ren_vid_surface *src = &comp->layers[layer];
+	const struct ren_vid_rect *bo = &src->blend_out;
+	struct ren_vid_rect sarea, darea, r;
+	int x1, y1;
+
+	layer_area(src, &sarea, &darea);
+	if (rect == NULL) {
+		add_damage(comp, &darea);
+		return;
+	}
+
+	if (!rect_intersect(&r, rect, &sarea))
+		return;
+
+	/* map to output co-ordinates, rounding outwards */
+	x1 = bo->x + ((r.x + r.w) * bo->w + src->w - 1) / src->w;
+	y1 = bo->y + ((r.y + r.h) * bo->h + src->h - 1) / src->h;
+	r.x = bo->x + r.x * bo->w / src->w;
+	r.y = bo->y + r.y * bo->h / src->h;
+	r.w = x1 - r.x;
+	r.h = y1 - r.y;
+
+	add_damage(comp, &r);
+}
+
+static size_t surface_bytes(const struct ren_vid_surface *s)
+{
+	return size_y(s->format, s->w * s->h, 0) +
+		size_c(s->format, s->w * s->h, 0);
+}
+
+/* The part of a layer under a region, in layer co-ordinates (sel) and where
+   it lands in the output (out). The selection is on the layer's chroma
+   sub-sampling grid, so out can reach past the region, but not the output. */
+static int layer_sel(
+	const SHVIO_COMPOSER *comp,
+	const struct ren_vid_surface *src,
+	const struct ren_vid_rect *region,
+	struct ren_vid_rect *sel,
+	struct ren_vid_rect *out)
+{
+	const struct ren_vid_rect *bo = &src->blend_out;
+	int hinc = horz_increment(src->format);
+	int vinc = vert_increment(src->format);
+	struct ren_vid_rect sarea, darea, ia;
+	int x1, y1;
+
+	layer_area(src, &sarea, &darea);
+	if (!rect_intersect(&ia, &darea, region))
+		return 0;
+
+	/* map back to layer co-ordinates, rounding outwards */
+	x1 = ((ia.x + ia.w - bo->x) * src->w + bo->w - 1) / bo->w;
+	y1 = ((ia.y + ia.h - bo->y) * src->h + bo->h - 1) / bo->h;
+	if (x1 > sarea.x + sarea.w)
+		x1 = sarea.x + sarea.w;
+	if (y1 > sarea.y + sarea.h)
+		y1 = sarea.y + sarea.h;
+	sel->x = ((ia.x - bo->x) * src->w / bo->w) & ~(hinc - 1);
+	sel->y = ((ia.y - bo->y) * src->h / bo->h) & ~(vinc - 1);
+	x1 = (x1 + hinc - 1) & ~(hinc - 1);
+	y1 = (y1 + vinc - 1) & ~(vinc - 1);
+
+	/* at the edges of the output, drop a sample instead */
+	if (bo->x + sel->x * bo->w / src->w < 0)
+		sel->x += hinc;
+	if (bo->y + sel->y * bo->h / src->h < 0)
+		sel->y += vinc;
+	if (x1 > src->w || bo->x + (x1 * bo->w + src->w - 1) / src->w > comp->dst.w)
+		x1 -= hinc;
+	if (y1 > src->h || bo->y + (y1 * bo->h + src->h - 1) / src->h > comp->dst.h)
+		y1 -= vinc;
+
+	sel->w = x1 - sel->x;
+	sel->h = y1 - sel->y;
+	out->x = bo->x + sel->x * bo->w / src->w;
+	out->y = bo->y + sel->y * bo->h / src->h;
+	out->w = bo->x + (x1 * bo->w + src->w - 1) / src->w - out->x;
+	out->h = bo->y + (y1 * bo->h + src->h - 1) / src->h - out->y;
+
+	return 1;
+}
+
+/* Grow a region on the output's chroma sub-sampling grid until it holds all
+   of every layer selection under it. Growing can bring in more layers, or
+   more of one: a layer that is off the output's grid takes the region out
+   to its own edge. */
+static void grow_region(
+	SHVIO_COMPOSER *comp,
+	const struct ren_vid_rect *region,
+	struct ren_vid_rect *out)
+{
+	int hinc = horz_increment(comp->dst.format);
+	int vinc = vert_increment(comp->dst.format);
+	struct ren_vid_rect sel, lo;
+	int x1, y1;
+	int grown;
+	int i;
+
+	*out = *region;
+	do {
+		grown = 0;
+		for (i = 0; i < comp->nr_layers; i++) {
+			if (!layer_sel(comp, &comp->layers[i], out, &sel, &lo))
+				continue;
+			if (rect_empty(&sel))
+				continue;
+
+			x1 = out->x + out->w;
+			y1 = out->y + out->h;
+			if (lo.x + lo.w > x1)
+				x1 = (lo.x + lo.w + hinc - 1) & ~(hinc - 1);
+			if (lo.y + lo.h > y1)
+				y1 = (lo.y + lo.h + vinc - 1) & ~(vinc - 1);
+			if (x1 > comp->dst.w)
+				x1 = comp->dst.w;
+			if (y1 > comp->dst.h)
+				y1 = comp->dst.h;
+			if (lo.x < out->x)
+				out->x = lo.x & ~(hinc - 1);
+			if (lo.y < out->y)
+				out->y = lo.y & ~(vinc - 1);
+
+			if (x1 - out->x != out->w || y1 - out->y != out->h)
+				grown = 1;
+			out->w = x1 - out->x;
+			out->h = y1 - out->y;
+		}
+	} while (grown);
+}
+
+/* Blend every layer that covers a damaged region into the output */
+static int compose_region(SHVIO_COMPOSER *comp, const struct ren_vid_rect *damage)
+{
+	struct ren_vid_surface srcs[SHVIO_COMPOSER_MAX_LAYERS];
+	const struct ren_vid_surface *list[SHVIO_COMPOSER_MAX_LAYERS];
+	struct ren_vid_surface dst;
+	struct ren_vid_rect region, virt;
+	size_t bytes = 0;
+	int n = 0;
+	int ret;
+	int i;
+
+	grow_region(comp, damage, &region);
+	get_sel_surface(&dst, &comp->dst, &region);
+
+	for (i = 0; i < comp->nr_layers; i++) {
+		const struct ren_vid_surface *src = &comp->layers[i];
+		struct ren_vid_rect sel, out;
+
+		if (!layer_sel(comp, src, &region, &sel, &out))
+			continue;
+
+		get_sel_surface(&srcs[n], src, &sel);
+		if (srcs[n].w <= 0 || srcs[n].h <= 0)
+			continue;
+
+		srcs[n].window.w = srcs[n].window.h = 0;
+		srcs[n].blend_out.x = out.x - region.x;
+		srcs[n].blend_out.y = out.y - region.y;
+		srcs[n].blend_out.w = out.w;
+		srcs[n].blend_out.h = out.h;
+
+		bytes += surface_bytes(&srcs[n]);
+		list[n] = &srcs[n];
+		n++;
+	}
+
+	if (n == 0) {
+		ret = shvio_fill(comp->vio, &dst, BACKGROUND_ARGB);
+	} else {
+		virt.x = 0;
+		virt.y = 0;
+		virt.w = dst.w;
+		virt.h = dst.h;
+		ret = shvio_setup_blend(comp->vio, &virt, list, n, &dst);
+		if (ret == 0) {
+			shvio_start(comp->vio);
+			ret = shvio_wait(comp->vio);
+		}
+	}
+
+	if (ret < 0)
+		return -1;
+
+	bytes += surface_bytes(&dst);
+	comp->stats.jobs++;
+	comp->stats.bytes += bytes;
+
+	return 0;
+}
+
+SHVIO_COMPOSER *
+shvio_composer_open(
+	SHVIO *vio,
+	const struct ren_vid_surface *dst)
+{
+	SHVIO_COMPOSER *comp;
+
+	if (!vio || !dst) {
+		debug_info("ERR: Invalid input - need vio and dest");
+		return NULL;
+	}
+
+	if (!vio->ops.setup_blend) {
+		debug_info("ERR: Unsupported by HW");
+		return NULL;
+	}
+
+	comp = calloc(1, sizeof(*comp));
+	if (!comp)
+		return NULL;
+
+	comp->vio = vio;
+	comp->dst = *dst;
+
+	return comp;
+}
+
+void
+shvio_composer_close(SHVIO_COMPOSER *comp)
+{
+	free(comp);
+}
+
+int
+shvio_composer_set_layers(
+	SHVIO_COMPOSER *comp,
+	const struct ren_vid_surface *const *src_list,
+	int src_count)
+{
+	struct ren_vid_rect whole = { 0, 0, comp->dst.w, comp->dst.h };
+	int i;
+
+	if (src_count < 0 || src_count > SHVIO_COMPOSER_MAX_LAYERS) {
+		debug_info("ERR: Invalid number of layers");
+		return -1;
+	}
+
+	for (i = 0; i < src_count; i++)
+		comp->layers[i] = *src_list[i];
+	comp->nr_layers = src_count;
+
+	comp->nr_damage = 0;
+	add_damage(comp, &whole);
+
+	return 0;
+}
+
+int
+shvio_composer_set_layer(
+	SHVIO_COMPOSER *comp,
+	int layer,
+	const struct ren_vid_surface *src)
+{
+	if (layer < 0 || layer >= comp->nr_layers) {
+		debug_info("ERR: Invalid layer");
+		return -1;
+	}
+
+	damage_layer(comp, layer, NULL);
+	comp->layers[layer] = *src;
+	damage_layer(comp, layer, NULL);
+
+	return 0;
+}
+
+void
+shvio_composer_damage(
+	SHVIO_COMPOSER *comp,
+	int layer,
+	const struct ren_vid_rect *rect)
+{
+	if (layer < 0 || layer >= comp->nr_layers)
+		return;
+
+	damage_layer(comp, layer, rect);
+}
+
+int
+shvio_composer_update(SHVIO_COMPOSER *comp)
+{
+	int ret = 0;
+
+	comp->stats.frames++;
+	comp->stats.jobs = 0;
+	comp->stats.bytes = 0;
+
+	while (comp->nr_damage > 0) {
+		const struct ren_vid_rect *region = &comp->damage[comp->nr_damage - 1];
+
+		if (compose_region(comp, region) < 0) {
+			debug_info("ERR: failed to compose a region");
+			ret = -1;
+			break;
+		}
+		comp->nr_damage--;
+	}
+
+	comp->stats.total_jobs += comp->stats.jobs;
+	comp->stats.total_bytes += comp->stats.bytes;
+
+	return ret;
+}
+
+void
+shvio_composer_get_stats(
+	SHVIO_COMPOSER *comp,
+	struct shvio_composer_stats *stats)
+{
+	*stats = comp->stats;
+}
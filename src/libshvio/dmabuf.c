@@ -0,0 +1,228 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Zero-copy import of dma-buf buffers
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_LINUX_DMA_BUF_H
+#include <linux/dma-buf.h>
+#endif
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+struct shvio_dmabuf {
+	int fd;
+	void *virt;
+	unsigned long phys;
+	size_t size;
+	struct shvio_dmabuf *next;
+};
+
+/* Find the physical address of a mapping from /proc/self/pagemap. This
+   only succeeds if the whole mapping is physically contiguous, and since
+   Linux 4.2 only with CAP_SYS_ADMIN: otherwise the kernel reports every
+   page frame number as 0. */
+static unsigned long pagemap_virt_to_phys(void *virt, size_t size)
+{
+	long page_size = sysconf(_SC_PAGESIZE);
+	unsigned long first = (unsigned long)virt / page_size;
+	unsigned long last = ((unsigned long)virt + size - 1) / page_size;
+	unsigned long page;
+	uint64_t entry, pfn = 0;
+	int fd;
+
+	fd = open("/proc/self/pagemap", O_RDONLY);
+	if (fd < 0) {
+		debug_info("ERR: Unable to open /proc/self/pagemap");
+		return 0;
+	}
+
+	for (page = first; page <= last; page++) {
+		if (pread(fd, &entry, sizeof(entry), page * sizeof(entry)) != sizeof(entry))
+			goto fail;
+
+		/* bit 63: present, bits 0-54: page frame number */
+		if (!(entry & (1ULL << 63)))
+			goto fail;
+		entry &= (1ULL << 55) - 1;
+		if (!entry) {
+			debug_info("ERR: Physical address hidden, a privileged process "
+				   "or the address from the exporter is needed");
+			goto fail;
+		}
+
+		if (page == first)
+			pfn = entry;
+		else if (entry != pfn + (page - first)) {
+			debug_info("ERR: dma-buf is not physically contiguous");
+			goto fail;
+		}
+	}
+
+	close(fd);
+	return pfn * page_size + ((unsigned long)virt % page_size);
+
+fail:
+	close(fd);
+	return 0;
+}
+
+void *
+shvio_dmabuf_import(
+	SHVIO *vio,
+	int fd,
+	size_t size,
+	unsigned long phys)
+{
+	struct shvio_dmabuf *buf;
+	void *virt;
+
+	if (!vio || fd < 0) {
+		debug_info("ERR: Invalid input - need dma-buf fd");
+		return NULL;
+	}
+
+	if (!size) {
+		off_t end = lseek(fd, 0, SEEK_END);
+		if (end <= 0) {
+			debug_info("ERR: Unable to get dma-buf size");
+			return NULL;
+		}
+		size = end;
+	}
+
+	buf = calloc(1, sizeof(*buf));
+	if (!buf)
+		return NULL;
+
+	virt = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_SHARED | MAP_POPULATE, fd, 0);
+	if (virt == MAP_FAILED) {
+		debug_info("ERR: Unable to map dma-buf");
+		goto fail_mmap;
+	}
+
+	if (!phys)
+		phys = pagemap_virt_to_phys(virt, size);
+	if (!phys)
+		goto fail_phys;
+
+	if (buffer_add(vio, virt, phys, size) < 0)
+		goto fail_phys;
+
+	if (uiomux_register(virt, phys, size) < 0) {
+		debug_info("ERR: Unable to register dma-buf");
+		buffer_remove(vio, virt);
+		goto fail_phys;
+	}
+
+	/* keep our own reference for cache maintenance */
+	buf->fd = dup(fd);
+	buf->virt = virt;
+	buf->phys = phys;
+	buf->size = size;
+	buf->next = vio->dmabufs;
+	vio->dmabufs = buf;
+
+	return virt;
+
+fail_phys:
+	munmap(virt, size);
+fail_mmap:
+	free(buf);
+	return NULL;
+}
+
+void
+shvio_dmabuf_release(
+	SHVIO *vio,
+	void *addr)
+{
+	struct shvio_dmabuf **p, *buf;
+
+	for (p = &vio->dmabufs; *p; p = &(*p)->next) {
+		buf = *p;
+		if (buf->virt == addr) {
+			*p = buf->next;
+			buffer_remove(vio, buf->virt);
+			uiomux_unregister(buf->virt);
+			munmap(buf->virt, buf->size);
+			if (buf->fd >= 0)
+				close(buf->fd);
+			free(buf);
+			return;
+		}
+	}
+}
+
+void
+dmabuf_release_all(SHVIO *vio)
+{
+	while (vio->dmabufs)
+		shvio_dmabuf_release(vio, vio->dmabufs->virt);
+}
+
+/* Cache maintenance of an imported dma-buf. Returns 1 if addr is not in an
+   imported dma-buf. */
+int
+dmabuf_sync(SHVIO *vio, const void *addr, int for_device)
+{
+	struct shvio_dmabuf *buf;
+
+	for (buf = vio->dmabufs; buf; buf = buf->next) {
+		if (addr >= buf->virt && addr < buf->virt + buf->size)
+			break;
+	}
+	if (!buf)
+		return 1;
+
+#ifdef HAVE_LINUX_DMA_BUF_H
+	{
+		struct dma_buf_sync sync;
+
+		/* The CPU access ends when the buffer is handed to the device */
+		sync.flags = DMA_BUF_SYNC_RW;
+		sync.flags |= for_device ? DMA_BUF_SYNC_END : DMA_BUF_SYNC_START;
+		if (buf->fd >= 0 && ioctl(buf->fd, DMA_BUF_IOCTL_SYNC, &sync) == 0)
+			return 0;
+	}
+#endif
+	debug_info("ERR: Unable to sync dma-buf");
+	return -1;
+}
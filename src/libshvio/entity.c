@@ -0,0 +1,543 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Entity allocator. All the entities an operation needs are taken at once,
+ * so two operations can never each hold part of what the other needs.
+ * Requests are served strictly in order of priority, then of arrival: a
+ * request that can be satisfied still waits while an earlier or higher
+ * priority request is waiting, so no request can be starved.
+ *
+ * Devices that are not shared between entities, such as the VEU, are queued
+ * for in the same way, each as a single entity of its own.
+ *
+ * Where shared memory and robust mutexes are available, the allocation
+ * table is shared by all processes, so pipelines from different processes
+ * can run at the same time on different entities. Entities held by a
+ * process that dies are given back. Otherwise, the table is private to
+ * the process.
+ *
+ * Every process that can open the shared table is trusted: it can hold
+ * entities for as long as it likes and can corrupt the table. By default
+ * only the user that created the table and its group can open it (see
+ * --with-entity-table-mode); the others fall back to a private table.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#if defined(HAVE_SHM_OPEN) && defined(HAVE_PTHREAD_MUTEXATTR_SETROBUST)
+#define SHARED_TABLE
+#endif
+
+#define SHM_NAME	"/libshvio-entities.2"	/* named after the layout */
+#ifndef ENTITY_TABLE_MODE
+#define ENTITY_TABLE_MODE	0660
+#endif
+#define SHM_MAGIC	0x5356494f	/* 'SVIO' */
+#define MAX_WAITERS	32
+#define RECLAIM_MS	100	/* how often waiters look for dead processes */
+#define DEVICE_FIRST	16	/* bit of the first whole device, after VIO6 */
+#define MAX_DEVICES	8
+
+struct alloc_waiter {
+	pid_t pid;		/* 0 if the slot is free */
+	int priority;
+	unsigned long ticket;
+};
+
+struct alloc_table {
+	volatile uint32_t magic;	/* set once the table is ready */
+	pthread_mutex_t lock;		/* protects the table */
+	pthread_cond_t cond;		/* entities freed or queue changed */
+	pthread_mutex_t hw_lock;	/* registers shared between entities */
+	uint32_t busy;			/* entities in use */
+	pid_t owner[MAX_ENTITIES];	/* process using each entity */
+	unsigned long ticket;
+	struct alloc_waiter waiters[MAX_WAITERS];
+	unsigned long dev_addr[MAX_DEVICES];	/* registers of each device */
+};
+
+static pthread_once_t alloc_once = PTHREAD_ONCE_INIT;
+static struct alloc_table local_table;
+static struct alloc_table *alloc = &local_table;
+
+static void table_init(struct alloc_table *t, int pshared)
+{
+	pthread_mutexattr_t mattr;
+	pthread_condattr_t cattr;
+
+	pthread_mutexattr_init(&mattr);
+	pthread_condattr_init(&cattr);
+#ifdef SHARED_TABLE
+	if (pshared) {
+		pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_SHARED);
+		pthread_mutexattr_setrobust(&mattr, PTHREAD_MUTEX_ROBUST);
+		pthread_condattr_setpshared(&cattr, PTHREAD_PROCESS_SHARED);
+	}
+#endif
+	/* timeouts must not be affected by changes to the wall clock */
+	pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+
+	pthread_mutex_init(&t->lock, &mattr);
+	pthread_mutex_init(&t->hw_lock, &mattr);
+	pthread_cond_init(&t->cond, &cattr);
+
+	pthread_condattr_destroy(&cattr);
+	pthread_mutexattr_destroy(&mattr);
+}
+
+#ifdef SHARED_TABLE
+static struct alloc_table *table_open_shared(void)
+{
+	const struct timespec delay = { 0, 1000 * 1000 };
+	struct alloc_table *t;
+	struct stat st;
+	int created = 1;
+	int fd, i;
+
+	fd = shm_open(SHM_NAME, O_RDWR | O_CREAT | O_EXCL, ENTITY_TABLE_MODE);
+	if (fd < 0 && errno == EEXIST) {
+		created = 0;
+		fd = shm_open(SHM_NAME, O_RDWR, 0);
+	}
+	if (fd < 0)
+		return NULL;
+
+	if (created) {
+		/* not narrowed by the umask */
+		fchmod(fd, ENTITY_TABLE_MODE);
+		if (ftruncate(fd, sizeof(*t)) < 0)
+			goto fail;
+	} else {
+		/* wait for the creator to size it */
+		for (i = 0; i < 1000; i++) {
+			if (fstat(fd, &st) < 0)
+				goto fail;
+			if (st.st_size >= (off_t)sizeof(*t))
+				break;
+			nanosleep(&delay, NULL);
+		}
+		if (i == 1000)
+			goto fail;
+	}
+
+	t = mmap(NULL, sizeof(*t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (t == MAP_FAILED)
+		return NULL;
+
+	if (created) {
+		table_init(t, 1);
+		__sync_synchronize();
+		t->magic = SHM_MAGIC;
+	} else {
+		/* wait for the creator to initialise it */
+		for (i = 0; i < 1000 && t->magic != SHM_MAGIC; i++)
+			nanosleep(&delay, NULL);
+		if (t->magic != SHM_MAGIC) {
+			munmap(t, sizeof(*t));
+			return NULL;
+		}
+		__sync_synchronize();
+	}
+
+	return t;
+
+fail:
+	close(fd);
+	return NULL;
+}
+
+static int process_dead(pid_t pid)
+{
+	return (kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+/* Give back the entities and queue slots of processes that have died */
+static int reclaim(struct alloc_table *t)
+{
+	int n = 0;
+	int i;
+
+	for (i = 0; i < MAX_ENTITIES; i++) {
+		if ((t->busy & (1 << i)) && process_dead(t->owner[i])) {
+			debug_info("LOG: reclaimed an entity of a dead process");
+			t->busy &= ~(1 << i);
+			t->owner[i] = 0;
+			n++;
+		}
+	}
+	for (i = 0; i < MAX_WAITERS; i++) {
+		if (t->waiters[i].pid && process_dead(t->waiters[i].pid)) {
+			t->waiters[i].pid = 0;
+			n++;
+		}
+	}
+
+	return n;
+}
+#endif
+
+/* Returns the number of entities and queue slots given back */
+static int reclaim_dead(void)
+{
+#ifdef SHARED_TABLE
+	if (alloc != &local_table)
+		return reclaim(alloc);
+#endif
+	return 0;
+}
+
+static void alloc_init(void)
+{
+#ifdef SHARED_TABLE
+	struct alloc_table *t = table_open_shared();
+
+	if (t) {
+		alloc = t;
+		return;
+	}
+	debug_info("LOG: entity table is private to this process");
+#endif
+	table_init(&local_table, 0);
+}
+
+/* A process that dies holding a robust mutex leaves it to the next locker */
+static int recover(pthread_mutex_t *lock, int ret)
+{
+#ifdef SHARED_TABLE
+	if (ret == EOWNERDEAD) {
+		if (lock == &alloc->lock)
+			reclaim(alloc);
+		pthread_mutex_consistent(lock);
+		ret = 0;
+	}
+#endif
+	return ret;
+}
+
+static void table_lock(pthread_mutex_t *lock)
+{
+	recover(lock, pthread_mutex_lock(lock));
+}
+
+static void add_ms(struct timespec *ts, int ms)
+{
+	ts->tv_sec += ms / 1000;
+	ts->tv_nsec += (ms % 1000) * 1000000;
+	if (ts->tv_nsec >= 1000000000) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000;
+	}
+}
+
+/* Wait for the table to change. A process that dies while waiting or
+   holding entities never signals that, so a shared table is also checked
+   for dead processes every RECLAIM_MS */
+static int table_wait(const struct timespec *deadline)
+{
+	int ret;
+
+#ifdef SHARED_TABLE
+	if (alloc != &local_table) {
+		struct timespec until;
+
+		reclaim(alloc);
+		clock_gettime(CLOCK_MONOTONIC, &until);
+		add_ms(&until, RECLAIM_MS);
+		if (!deadline || until.tv_sec < deadline->tv_sec ||
+		    (until.tv_sec == deadline->tv_sec &&
+		     until.tv_nsec < deadline->tv_nsec)) {
+			ret = pthread_cond_timedwait(&alloc->cond, &alloc->lock,
+						     &until);
+			ret = recover(&alloc->lock, ret);
+			return (ret == ETIMEDOUT) ? 0 : ret;
+		}
+	}
+#endif
+
+	if (deadline)
+		ret = pthread_cond_timedwait(&alloc->cond, &alloc->lock, deadline);
+	else
+		ret = pthread_cond_wait(&alloc->cond, &alloc->lock);
+
+	return recover(&alloc->lock, ret);
+}
+
+/* Find free entities for each function, without taking them */
+static int
+pick(const struct shvio_entity *table, int n_table, uint32_t busy,
+     const int *funcs, int n, int *idx)
+{
+	int i, j;
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < n_table; j++) {
+			if (!(busy & (1 << j)) && (table[j].funcs & funcs[i]))
+				break;
+		}
+		if (j == n_table)
+			return -1;
+		idx[i] = j;
+		busy |= 1 << j;
+	}
+
+	return 0;
+}
+
+/* Is the waiter the next one to be served? */
+static int is_head(const struct alloc_table *t, const struct alloc_waiter *w)
+{
+	int i;
+
+	for (i = 0; i < MAX_WAITERS; i++) {
+		const struct alloc_waiter *o = &t->waiters[i];
+
+		if (o == w || o->pid == 0)
+			continue;
+		if (o->priority > w->priority ||
+		    (o->priority == w->priority && o->ticket < w->ticket))
+			return 0;
+	}
+
+	return 1;
+}
+
+static struct alloc_waiter *enqueue(struct alloc_table *t, int priority)
+{
+	int i;
+
+	for (i = 0; i < MAX_WAITERS; i++) {
+		struct alloc_waiter *w = &t->waiters[i];
+
+		if (w->pid == 0) {
+			w->pid = getpid();
+			w->priority = priority;
+			w->ticket = t->ticket++;
+			return w;
+		}
+	}
+
+	return NULL;
+}
+
+/* Take entities of a table, whose entity i is bit first + i of the
+   allocation table */
+static int
+alloc_bits(
+	SHVIO *vio,
+	struct shvio_entity *table,
+	int n_table,
+	int first,
+	const int *funcs,
+	int n,
+	struct shvio_entity **out)
+{
+	struct alloc_waiter *self;
+	struct timespec start, deadline;
+	int idx[MAX_ENTITIES];
+	unsigned long waited;
+	int blocked = 0;
+	int ret = 0;
+	int i;
+
+	if (n > MAX_ENTITIES || first + n_table > MAX_ENTITIES) {
+		debug_info("ERR: too many entities");
+		return -1;
+	}
+
+	/* a job that needs more than the hardware has would wait for ever, and
+	   hold up every waiter behind it */
+	if (pick(table, n_table, 0, funcs, n, idx) < 0) {
+		debug_info("ERR: job needs more entities than the hardware has");
+		return -1;
+	}
+
+	pthread_once(&alloc_once, alloc_init);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	deadline = start;
+	if (vio->timeout_ms > 0)
+		add_ms(&deadline, vio->timeout_ms);
+
+	table_lock(&alloc->lock);
+
+	self = enqueue(alloc, vio->priority);
+	if (!self) {
+		pthread_mutex_unlock(&alloc->lock);
+		debug_info("ERR: too many waiters");
+		return -1;
+	}
+
+	while (!is_head(alloc, self) ||
+	       pick(table, n_table, alloc->busy >> first, funcs, n, idx) < 0) {
+		if (vio->timeout_ms == 0) {
+			/* a dead process may be all that is in the way */
+			if (reclaim_dead())
+				continue;
+			ret = ETIMEDOUT;
+			break;
+		}
+		blocked = 1;
+		ret = table_wait((vio->timeout_ms > 0) ? &deadline : NULL);
+		if (ret != 0)
+			break;
+	}
+
+	self->pid = 0;
+	if (ret == 0) {
+		for (i = 0; i < n; i++) {
+			alloc->busy |= 1 << (first + idx[i]);
+			alloc->owner[first + idx[i]] = getpid();
+			out[i] = &table[idx[i]];
+		}
+	}
+
+	/* the head of the queue has changed */
+	pthread_cond_broadcast(&alloc->cond);
+	pthread_mutex_unlock(&alloc->lock);
+
+	if (ret == 0) {
+		vio->stats.allocs++;
+	} else {
+		debug_info("LOG: no entity available");
+		if (vio->timeout_ms != 0)
+			vio->stats.alloc_timeouts++;
+	}
+	if (blocked) {
+		waited = elapsed_us(&start);
+		vio->stats.alloc_waits++;
+		vio->stats.alloc_wait_us += waited;
+		if (waited > vio->stats.alloc_max_wait_us)
+			vio->stats.alloc_max_wait_us = waited;
+	}
+
+	return (ret == 0) ? 0 : -1;
+}
+
+static void free_bit(int i)
+{
+	pthread_once(&alloc_once, alloc_init);
+
+	table_lock(&alloc->lock);
+	alloc->busy &= ~(1 << i);
+	alloc->owner[i] = 0;
+	pthread_cond_broadcast(&alloc->cond);
+	pthread_mutex_unlock(&alloc->lock);
+}
+
+int
+entity_alloc(
+	SHVIO *vio,
+	struct shvio_entity *table,
+	int n_table,
+	const int *funcs,
+	int n,
+	struct shvio_entity **out)
+{
+	return alloc_bits(vio, table, n_table, 0, funcs, n, out);
+}
+
+void
+entity_free(
+	struct shvio_entity *table,
+	struct shvio_entity *entity)
+{
+	free_bit(entity - table);
+}
+
+/* The slot of a device, found by the address of its registers, which all
+   processes agree on. Slots are never given back. */
+static int device_slot(unsigned long addr)
+{
+	int i;
+
+	for (i = 0; i < MAX_DEVICES; i++) {
+		if (alloc->dev_addr[i] == addr)
+			return i;
+		if (alloc->dev_addr[i] == 0) {
+			alloc->dev_addr[i] = addr;
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+int device_lock(SHVIO *vio)
+{
+	static struct shvio_entity device = {
+		.funcs = SHVIO_FUNC_SRC | SHVIO_FUNC_CSC | SHVIO_FUNC_SCALE |
+			 SHVIO_FUNC_CROP | SHVIO_FUNC_EFFECT | SHVIO_FUNC_BLEND |
+			 SHVIO_FUNC_SINK,
+	};
+	static const int funcs[] = { SHVIO_FUNC_SINK };
+	struct shvio_entity *out;
+	int slot;
+
+	pthread_once(&alloc_once, alloc_init);
+
+	table_lock(&alloc->lock);
+	slot = device_slot(vio->uio_mmio.address);
+	pthread_mutex_unlock(&alloc->lock);
+	if (slot < 0) {
+		debug_info("ERR: too many devices");
+		return -1;
+	}
+
+	vio->device_slot = slot;
+	return alloc_bits(vio, &device, 1, DEVICE_FIRST + slot, funcs, 1, &out);
+}
+
+void device_unlock(SHVIO *vio)
+{
+	free_bit(DEVICE_FIRST + vio->device_slot);
+}
+
+void entity_hw_lock(void)
+{
+	pthread_once(&alloc_once, alloc_init);
+	table_lock(&alloc->hw_lock);
+}
+
+void entity_hw_unlock(void)
+{
+	pthread_mutex_unlock(&alloc->hw_lock);
+}
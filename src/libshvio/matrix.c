@@ -0,0 +1,176 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Colour correction matrix support
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+
+#include "common.h"
+
+/* YCbCr to RGB conversion, [bt709][full_range]. Rows are R, G, B and
+   columns Cr, Y, Cb, as in the VEU2H VMCR registers. 2048 is 1.0 */
+static const int ycbcr_to_rgb[2][2][3][3] = {
+	{
+		{ { 3269, 2384,    0 }, { -1665, 2384, -803 }, { 0, 2384, 4131 } },
+		{ { 2871, 2048,    0 }, { -1463, 2048, -705 }, { 0, 2048, 3629 } },
+	},
+	{
+		{ { 3672, 2384,    0 }, { -1092, 2384, -436 }, { 0, 2384, 4325 } },
+		{ { 3225, 2048,    0 }, {  -959, 2048, -384 }, { 0, 2048, 3800 } },
+	},
+};
+
+/* Byte offsets of R, G and B in packed RGB formats */
+struct rgb_layout {
+	int bpp;
+	int r, g, b;
+};
+
+static const struct rgb_layout rgb_layouts[] = {
+	[REN_RGB24]  = { 3, 0, 1, 2 },
+	[REN_BGR24]  = { 3, 2, 1, 0 },
+	[REN_RGB32]  = { 4, 3, 2, 1 },
+	[REN_BGR32]  = { 4, 0, 1, 2 },
+	[REN_XRGB32] = { 4, 2, 1, 0 },
+	[REN_BGRA32] = { 4, 0, 1, 2 },
+	[REN_ARGB32] = { 4, 2, 1, 0 },
+};
+
+static int round_q11(long v)
+{
+	return (v >= 0) ? (v + 1024) / 2048 : -((-v + 1024) / 2048);
+}
+
+/* Merge the correction matrix with the YCbCr to RGB conversion, giving the
+   VEU2H register values. Fails if the result cannot be represented. */
+int
+matrix_fuse(
+	const struct shvio_color_matrix *m,
+	int bt709,
+	int full_range,
+	uint32_t vmcr[9],
+	uint32_t *vcoffr)
+{
+	const int (*base)[3] = ycbcr_to_rgb[!!bt709][!!full_range];
+	int i, j, k;
+
+	/* The hardware only has input offsets */
+	if (m->offset[0] || m->offset[1] || m->offset[2])
+		return -1;
+
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < 3; j++) {
+			long sum = 0;
+			int coeff;
+
+			for (k = 0; k < 3; k++)
+				sum += (long)m->coeff[i][k] * base[k][j];
+			coeff = round_q11(sum);
+
+			/* 14-bit two's complement */
+			if (coeff < -8192 || coeff > 8191)
+				return -1;
+			if (vmcr)
+				vmcr[i * 3 + j] = coeff & 0x3fff;
+		}
+	}
+
+	if (vcoffr)
+		*vcoffr = full_range ? 0x00800000 : 0x00800010;
+
+	return 0;
+}
+
+int
+matrix_supported(ren_vid_format_t format)
+{
+	if (format < 0 || format >= sizeof(rgb_layouts) / sizeof(rgb_layouts[0]))
+		return 0;
+	return rgb_layouts[format].bpp != 0;
+}
+
+static inline uint8_t clamp_u8(int v)
+{
+	if (v < 0)
+		return 0;
+	if (v > 255)
+		return 255;
+	return v;
+}
+
+/* Always inlined with constant layouts so that the compiler can vectorize
+   each variant */
+static inline __attribute__((always_inline)) void
+apply_row(uint8_t *p, int w, const int *c, const int *o,
+	  int bpp, int r, int g, int b)
+{
+	int x;
+
+	for (x = 0; x < w; x++, p += bpp) {
+		int in_r = p[r], in_g = p[g], in_b = p[b];
+
+		p[r] = clamp_u8(((c[0] * in_r + c[1] * in_g + c[2] * in_b + 1024) >> 11) + o[0]);
+		p[g] = clamp_u8(((c[3] * in_r + c[4] * in_g + c[5] * in_b + 1024) >> 11) + o[1]);
+		p[b] = clamp_u8(((c[6] * in_r + c[7] * in_g + c[8] * in_b + 1024) >> 11) + o[2]);
+	}
+}
+
+void
+matrix_apply(
+	const struct shvio_color_matrix *m,
+	const struct ren_vid_surface *s)
+{
+	const struct rgb_layout *l;
+	size_t bpitch;
+	uint8_t *p;
+	int c[9];
+	int y;
+
+	if (!matrix_supported(s->format))
+		return;
+
+	l = &rgb_layouts[s->format];
+	bpitch = size_y(s->format, s->pitch, s->bpitchy);
+	memcpy(c, m->coeff, sizeof(c));
+
+	for (y = 0, p = s->py; y < s->h; y++, p += bpitch) {
+		if (l->bpp == 3 && l->r == 0)
+			apply_row(p, s->w, c, m->offset, 3, 0, 1, 2);
+		else if (l->bpp == 3)
+			apply_row(p, s->w, c, m->offset, 3, 2, 1, 0);
+		else if (l->r == 3)
+			apply_row(p, s->w, c, m->offset, 4, 3, 2, 1);
+		else if (l->r == 0)
+			apply_row(p, s->w, c, m->offset, 4, 0, 1, 2);
+		else
+			apply_row(p, s->w, c, m->offset, 4, 2, 1, 0);
+	}
+}
@@ -0,0 +1,64 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Static tracepoints (USDT) of the "libshvio" provider. A probe that is not
+ * in use is a single nop. Every probe starts with the job id, which all the
+ * stripes of an operation share, and the device name:
+ *
+ *   setup(job, dev, src_fmt, src_w, src_h, dst_fmt, dst_w, dst_h)
+ *   lock(job, dev)                   the device or the entities are held
+ *   entity_lock(job, dev, mask)      VIO6 entities taken, by table index
+ *   link(job, dev, src, sink, pad)   VIO6 entities connected, by table index
+ *   start(job, dev, lines)           the hardware is started
+ *   wake(job, dev, status)           woken by an interrupt
+ *   copy_back(job, dev, y, lines)    destination lines are finished
+ *   unlock(job, dev)                 the device or the entities are given up
+ */
+
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+#ifdef HAVE_SYS_SDT_H
+#include <sys/sdt.h>
+
+#define PROBE2(probe, vio) \
+	STAP_PROBE2(libshvio, probe, (vio)->job_id, (vio)->dev_name)
+#define PROBE3(probe, vio, a) \
+	STAP_PROBE3(libshvio, probe, (vio)->job_id, (vio)->dev_name, a)
+#define PROBE4(probe, vio, a, b) \
+	STAP_PROBE4(libshvio, probe, (vio)->job_id, (vio)->dev_name, a, b)
+#define PROBE5(probe, vio, a, b, c) \
+	STAP_PROBE5(libshvio, probe, (vio)->job_id, (vio)->dev_name, a, b, c)
+#define PROBE8(probe, vio, a, b, c, d, e, f) \
+	STAP_PROBE8(libshvio, probe, (vio)->job_id, (vio)->dev_name, a, b, c, d, e, f)
+#else
+#define PROBE2(probe, vio)			do { } while (0)
+#define PROBE3(probe, vio, a)			do { } while (0)
+#define PROBE4(probe, vio, a, b)		do { } while (0)
+#define PROBE5(probe, vio, a, b, c)		do { } while (0)
+#define PROBE8(probe, vio, a, b, c, d, e, f)	do { } while (0)
+#endif
+
+#endif /* __PROBES_H__ */
@@ -0,0 +1,309 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+/* Addresses of a slice, worked out ahead of time */
+struct slice_addr {
+	int y;			/* first source line, -1 if not worked out */
+	uint32_t src_py;
+	uint32_t src_pc;
+	uint32_t dst_py;
+	uint32_t dst_pc;
+};
+
+struct SHVIO_STREAM {
+	SHVIO *vio;
+	struct ren_vid_surface src;
+	struct ren_vid_surface dst;
+	int ring_lines;
+	int slice_lines;
+	shvio_stream_callback_t callback;
+	void *data;
+
+	int active;		/* a frame is set up on the hardware */
+	int busy;		/* a slice is running */
+	int lines_pushed;	/* source lines ready */
+	int lines_started;	/* source lines given to the hardware */
+	int lines_read;		/* source lines of completed slices */
+	int dst_lines_notified;	/* destination lines passed to the callback */
+	struct slice_addr next;	/* addresses of the next slice */
+};
+
+/* Pass the destination lines finished since the last call to the consumer */
+static void notify(SHVIO_STREAM *s)
+{
+	SHVIO *vio = s->vio;
+	int y = s->dst_lines_notified;
+
+	if (vio->dst_lines_done <= y)
+		return;
+
+	s->dst_lines_notified = vio->dst_lines_done;
+	if (s->callback)
+		s->callback(s->data, y, vio->dst_lines_done - y);
+}
+
+static int start_frame(SHVIO_STREAM *s)
+{
+	if (shvio_setup(s->vio, &s->src, &s->dst, SHVIO_NO_ROT) < 0)
+		return -1;
+
+	s->active = 1;
+	s->lines_pushed = 0;
+	s->lines_started = 0;
+	s->lines_read = 0;
+	s->dst_lines_notified = 0;
+	s->next.y = -1;
+
+	return 0;
+}
+
+/* Number of source lines for the next slice, 0 if it is not ready */
+static int next_slice_lines(SHVIO_STREAM *s)
+{
+	int avail = s->lines_pushed - s->lines_started;
+
+	if (avail >= s->slice_lines)
+		return s->slice_lines;
+
+	/* the last slice of a frame may be short */
+	if (s->lines_pushed == s->src.h)
+		return avail;
+
+	return 0;
+}
+
+/* Work out the addresses of the slice starting at source line y */
+static void get_slice_addr(SHVIO_STREAM *s, int y, struct slice_addr *a)
+{
+	SHVIO *vio = s->vio;
+	struct ren_vid_surface slice;
+	struct ren_vid_rect sel;
+
+	/* source lines, wrapping around the ring */
+	sel.x = 0;
+	sel.y = s->ring_lines ? y % s->ring_lines : y;
+	sel.w = s->src.w;
+	sel.h = s->slice_lines;
+	get_sel_surface(&slice, &s->src, &sel);
+	a->src_py = vio_virt_to_phys(vio, slice.py);
+	a->src_pc = vio_virt_to_phys(vio, slice.pc);
+
+	/* destination lines follow on from the previous slice */
+	sel.y = dst_lines_for(vio, y);
+	sel.w = vio->dst_hw.w;
+	get_sel_surface(&slice, &vio->dst_hw, &sel);
+	a->dst_py = vio_virt_to_phys(vio, slice.py);
+	a->dst_pc = vio_virt_to_phys(vio, slice.pc);
+
+	a->y = y;
+}
+
+static void start_slice(SHVIO_STREAM *s, int lines)
+{
+	SHVIO *vio = s->vio;
+
+	if (s->next.y != s->lines_started)
+		get_slice_addr(s, s->lines_started, &s->next);
+
+	shvio_set_src_phys(vio, s->next.src_py, s->next.src_pc);
+	shvio_set_dst_phys(vio, s->next.dst_py, s->next.dst_pc);
+
+	/* this also finishes the lines of the previous slice */
+	shvio_start_bundle(vio, lines);
+	s->lines_started += lines;
+	s->busy = 1;
+
+	/* queue the addresses of the next slice while the hardware works */
+	if (s->lines_started < s->src.h)
+		get_slice_addr(s, s->lines_started, &s->next);
+}
+
+static int wait_slice(SHVIO_STREAM *s)
+{
+	int complete;
+
+	complete = shvio_wait(s->vio);
+	s->busy = 0;
+	if (complete < 0) {
+		debug_info("ERR: slice failed");
+		s->active = 0;
+		return -1;
+	}
+
+	s->lines_read = s->lines_started;
+	if (complete) {
+		s->active = 0;
+	} else if (s->lines_started == s->src.h) {
+		debug_info("ERR: frame did not complete");
+		s->active = 0;
+		return -1;
+	}
+
+	return complete;
+}
+
+SHVIO_STREAM *
+shvio_stream_open(
+	SHVIO *vio,
+	const struct ren_vid_surface *src,
+	const struct ren_vid_surface *dst,
+	int ring_lines,
+	int slice_lines,
+	shvio_stream_callback_t callback,
+	void *data)
+{
+	SHVIO_STREAM *s;
+
+	if (!vio || !src || !dst) {
+		debug_info("ERR: Invalid input - need src and dest");
+		return NULL;
+	}
+
+	if (!shvio_has_bundle(vio)) {
+		debug_info("ERR: Bundle mode unsupported by HW");
+		return NULL;
+	}
+
+	/* Slices are addressed with the Y and first chroma plane only */
+	if (is_ycbcr_planar(src->format) || is_ycbcr_planar(dst->format) ||
+	    src->pa) {
+		debug_info("ERR: Unsupported surface format for streaming");
+		return NULL;
+	}
+
+	if (slice_lines <= 0 || slice_lines % vert_increment(src->format)) {
+		debug_info("ERR: Invalid slice size");
+		return NULL;
+	}
+
+	if (ring_lines < 0 || (ring_lines && ring_lines % slice_lines)) {
+		debug_info("ERR: Ring size is not a multiple of the slice size");
+		return NULL;
+	}
+
+	/* The producer writes straight into the source, so no bounce buffer */
+	if (!vio_virt_to_phys(vio, src->py) ||
+	    (src->pc && !vio_virt_to_phys(vio, src->pc))) {
+		debug_info("ERR: src is not accessible by hardware");
+		return NULL;
+	}
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return NULL;
+
+	s->vio = vio;
+	s->src = *src;
+	s->dst = *dst;
+	s->ring_lines = ring_lines;
+	s->slice_lines = slice_lines;
+	s->callback = callback;
+	s->data = data;
+
+	return s;
+}
+
+void
+shvio_stream_close(SHVIO_STREAM *s)
+{
+	if (!s)
+		return;
+
+	/* let a frame in progress run to the end */
+	while (s->active && s->lines_started < s->src.h) {
+		if (shvio_stream_push(s, s->src.h - s->lines_pushed) < 0)
+			break;
+	}
+	if (s->active)
+		shvio_stream_sync(s);
+
+	free(s);
+}
+
+int
+shvio_stream_push(SHVIO_STREAM *s, int lines)
+{
+	int n;
+
+	if (!s || lines < 0) {
+		debug_info("ERR: Invalid input");
+		return -1;
+	}
+
+	/* all the lines of the frame were pushed, so this starts the next */
+	if (s->active && s->lines_pushed == s->src.h) {
+		if (shvio_stream_sync(s) < 0)
+			return -1;
+	}
+
+	if (!s->active) {
+		if (start_frame(s) < 0)
+			return -1;
+	}
+
+	s->lines_pushed += lines;
+	if (s->lines_pushed > s->src.h)
+		s->lines_pushed = s->src.h;
+
+	while ((n = next_slice_lines(s)) > 0) {
+		if (s->busy && wait_slice(s) != 0)
+			return -1;
+		start_slice(s, n);
+		notify(s);
+	}
+
+	return s->lines_read;
+}
+
+int
+shvio_stream_sync(SHVIO_STREAM *s)
+{
+	if (!s) {
+		debug_info("ERR: Invalid input");
+		return -1;
+	}
+
+	if (!s->busy)
+		return 0;
+
+	if (wait_slice(s) < 0)
+		return -1;
+
+	finish_dst_lines(s->vio);
+	notify(s);
+
+	return 0;
+}
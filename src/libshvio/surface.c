@@ -0,0 +1,179 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Surface marshalling: bounce buffers for surfaces the hardware cannot access
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+static void copy_plane(void *dst, const void *src, size_t len, int lines,
+		       int dst_bpitch, int src_bpitch)
+{
+	int y;
+
+	if (!src || !dst || dst == src)
+		return;
+
+	debug_info("MEMCPY a plane");
+
+	/* contiguous lines, a single copy */
+	if (dst_bpitch == src_bpitch && (size_t)src_bpitch == len) {
+		memcpy(dst, src, len * lines);
+		return;
+	}
+
+	for (y = 0; y < lines; y++) {
+		memcpy(dst, src, len);
+		src += src_bpitch;
+		dst += dst_bpitch;
+	}
+}
+
+/* Copy active surface contents - assumes output is big enough */
+void copy_surface(
+	struct ren_vid_surface *out,
+	const struct ren_vid_surface *in)
+{
+	const struct format_info *fmt = &fmts[in->format];
+	int c_lines = in->h / fmt->c_ss_vert;
+	size_t c_len = chroma_bpitch(in->format, in->w);
+
+	copy_plane(out->py, in->py, size_y(in->format, in->w, 0), in->h,
+		   bpitch_y(out), bpitch_y(in));
+	copy_plane(out->pc, in->pc, c_len, c_lines,
+		   bpitch_c(out), bpitch_c(in));
+	if (is_ycbcr_planar(in->format))
+		copy_plane(out->pc2, in->pc2, c_len, c_lines,
+			   bpitch_c(out), bpitch_c(in));
+	copy_plane(out->pa, in->pa, in->w, in->h,
+		   bpitch_a(out), bpitch_a(in));
+}
+
+/* Get a bounce buffer of at least len bytes. Bounce buffers are kept
+   until the handle is closed, and only grow. */
+static void *get_bounce(SHVIO *vio, int slot, size_t len)
+{
+	struct shvio_bounce *b = &vio->bounce[slot];
+
+	if (b->size < len) {
+		if (b->p)
+			uiomux_free(vio->uiomux, vio->uiores, b->p, b->size);
+		b->size = 0;
+		b->p = uiomux_malloc(vio->uiomux, vio->uiores, len, 32);
+		if (!b->p)
+			return NULL;
+		b->size = len;
+	}
+
+	return b->p;
+}
+
+void release_bounce(SHVIO *vio)
+{
+	int i;
+
+	for (i = 0; i < N_BOUNCE; i++) {
+		struct shvio_bounce *b = &vio->bounce[i];
+
+		if (b->p)
+			uiomux_free(vio->uiomux, vio->uiores, b->p, b->size);
+		b->p = NULL;
+		b->size = 0;
+	}
+}
+
+/* Check/create surface that can be accessed by the hardware */
+int get_hw_surface(
+	SHVIO *vio,
+	int slot,
+	struct ren_vid_surface *out,
+	const struct ren_vid_surface *in)
+{
+	const struct format_info *fmt;
+	size_t y_len, c_len, a_len, len;
+	int alloc = 0;
+	int lines;
+	void *p;
+
+	if (in == NULL || out == NULL)
+		return 0;
+
+	*out = *in;
+	if (in->py) alloc |= !vio_virt_to_phys(vio, in->py);
+	if (in->pc) alloc |= !vio_virt_to_phys(vio, in->pc);
+	if (in->pc2) alloc |= !vio_virt_to_phys(vio, in->pc2);
+	if (in->pa) alloc |= !vio_virt_to_phys(vio, in->pa);
+
+	if (!alloc)
+		return 0;
+
+	/* One of the supplied buffers is not usable by the hardware! Use a
+	   buffer with the planes packed together, in the order Y, Cr, CbCr/Cb,
+	   alpha, with no padding */
+	fmt = &fmts[in->format];
+	lines = (in->h + fmt->c_ss_vert - 1) / fmt->c_ss_vert;
+
+	out->pitch = in->w;
+	out->bpitchy = size_y(in->format, in->w, 0);
+	out->bpitchc = chroma_bpitch(in->format, in->w);
+	out->bpitcha = in->w;
+
+	y_len = (size_t)out->bpitchy * lines * fmt->c_ss_vert;
+	c_len = (size_t)out->bpitchc * lines;
+	a_len = (size_t)out->bpitcha * lines * fmt->c_ss_vert;
+
+	len = y_len;
+	if (in->pc) len += c_len;
+	if (in->pc2) len += c_len;
+	if (in->pa) len += a_len;
+
+	p = get_bounce(vio, slot, len);
+	if (!p)
+		return -1;
+
+	out->py = p;
+	p += y_len;
+	if (in->pc2) {
+		out->pc2 = p;
+		p += c_len;
+	}
+	if (in->pc) {
+		out->pc = p;
+		p += c_len;
+	}
+	if (in->pa)
+		out->pa = p;
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Register access trace. read_reg() and write_reg() only know the register
+ * mapping, so each traced mapping has a ring of its most recent accesses.
+ * Writers claim a record with an atomic increment and never wait; a record
+ * carries its position, written last, so a reader can tell a complete
+ * record from one that is being overwritten. Rings are never freed, as a
+ * reader may still be looking at one; closing a handle gives its ring up
+ * for the next handle that is traced.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#define TRACE_RECORDS	4096	/* per ring, a power of two */
+#define TRACE_RINGS	8
+
+struct trace_record {
+	volatile unsigned long seq;	/* position + 1, 0 while being written */
+	uint64_t ns;
+	uint32_t reg;
+	uint32_t value;
+	int write;
+};
+
+struct trace_ring {
+	void *base;		/* register mapping */
+	volatile int on;
+	unsigned long head;	/* records claimed */
+	struct trace_record rec[TRACE_RECORDS];
+};
+
+int trace_enabled;
+static struct trace_ring *volatile rings[TRACE_RINGS];
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct trace_ring *find_ring(const void *base)
+{
+	struct trace_ring *r;
+	int i;
+
+	if (!base)
+		return NULL;
+
+	/* rings are added in order and never removed */
+	for (i = 0; i < TRACE_RINGS && (r = rings[i]) != NULL; i++) {
+		if (r->base == base)
+			return r;
+	}
+
+	return NULL;
+}
+
+void trace_record(void *base, int reg, uint32_t value, int write)
+{
+	struct trace_ring *r = find_ring(base);
+	struct trace_record *e;
+	struct timespec now;
+	unsigned long pos;
+
+	if (!r || !r->on)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pos = __sync_fetch_and_add(&r->head, 1);
+	e = &r->rec[pos & (TRACE_RECORDS - 1)];
+
+	e->seq = 0;
+	__sync_synchronize();
+	e->ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+	e->reg = reg;
+	e->value = value;
+	e->write = write;
+	__sync_synchronize();
+	e->seq = pos + 1;
+}
+
+/* Trace a new handle if SHVIO_TRACE is set */
+void trace_open(SHVIO *vio)
+{
+	const char *env = getenv("SHVIO_TRACE");
+
+	if (env && *env && strcmp(env, "0") != 0)
+		shvio_trace_enable(vio, 1);
+}
+
+/* Give up the ring of a handle that is being closed */
+void trace_close(SHVIO *vio)
+{
+	struct trace_ring *r;
+
+	if (!trace_enabled)
+		return;
+
+	pthread_mutex_lock(&rings_lock);
+	r = find_ring(vio->uio_mmio.iomem);
+	if (r) {
+		r->on = 0;
+		__sync_synchronize();
+		r->base = NULL;
+	}
+	pthread_mutex_unlock(&rings_lock);
+}
+
+/* Write the trace of a handle to stderr after an error */
+void trace_error(SHVIO *vio)
+{
+	struct trace_ring *r;
+
+	if (!trace_enabled)
+		return;
+
+	r = find_ring(vio->uio_mmio.iomem);
+	if (r && r->on) {
+		fprintf(stderr, "libshvio: register accesses before the error:\n");
+		shvio_trace_dump(vio, stderr);
+	}
+}
+
+int
+shvio_trace_enable(
+	SHVIO *vio,
+	int enable)
+{
+	void *base = vio->uio_mmio.iomem;
+	struct trace_ring *r;
+	int i;
+
+	pthread_mutex_lock(&rings_lock);
+
+	r = find_ring(base);
+	if (!r && enable) {
+		/* a ring given up by a closed handle, or a new one */
+		for (i = 0; i < TRACE_RINGS && rings[i] && rings[i]->base; i++)
+			;
+		if (i == TRACE_RINGS) {
+			debug_info("ERR: too many traced handles");
+			goto fail;
+		}
+		if (rings[i]) {
+			r = rings[i];
+			memset(r->rec, 0, sizeof(r->rec));
+			r->head = 0;
+			__sync_synchronize();
+			r->base = base;
+		} else {
+			r = calloc(1, sizeof(*r));
+			if (!r)
+				goto fail;
+			r->base = base;
+			__sync_synchronize();
+			rings[i] = r;
+		}
+		trace_enabled = 1;
+	}
+	if (r)
+		r->on = enable;
+
+	pthread_mutex_unlock(&rings_lock);
+	return 0;
+
+fail:
+	pthread_mutex_unlock(&rings_lock);
+	return -1;
+}
+
+void
+shvio_trace_dump(
+	SHVIO *vio,
+	FILE *fp)
+{
+	struct trace_ring *r = find_ring(vio->uio_mmio.iomem);
+	struct trace_record copy, *e;
+	unsigned long pos, head;
+	char name[32];
+
+	if (!r)
+		return;
+
+	head = r->head;
+	pos = (head > TRACE_RECORDS) ? head - TRACE_RECORDS : 0;
+	for (; pos < head; pos++) {
+		e = &r->rec[pos & (TRACE_RECORDS - 1)];
+
+		/* skip records that are being written or were overwritten */
+		if (e->seq != pos + 1)
+			continue;
+		__sync_synchronize();
+		copy = *e;
+		__sync_synchronize();
+		if (e->seq != pos + 1)
+			continue;
+
+		if (vio->ops.reg_name)
+			vio->ops.reg_name(copy.reg, name, sizeof(name));
+		else
+			snprintf(name, sizeof(name), "0x%04x", copy.reg);
+
+		fprintf(fp, "%5lu.%09lu %s %-20s 0x%08x\n",
+			(unsigned long)(copy.ns / 1000000000),
+			(unsigned long)(copy.ns % 1000000000),
+			copy.write ? "W" : "R", name, copy.value);
+	}
+}
@@ -40,7 +40,6 @@
 #include <uiomux/uiomux.h>
 #include "veu_regs.h"
 
-/* #define DEBUG 2 */
 #include "common.h"
 
 #include <endian.h>
@@ -63,26 +62,26 @@ struct vio_format_info {
 };
 
 static const struct vio_format_info vio_fmts[] = {
-	{ REN_NV12,   VTRCR_SRC_FMT_YCBCR420, VTRCR_DST_FMT_YCBCR420, 7 },
-	{ REN_NV16,   VTRCR_SRC_FMT_YCBCR422, VTRCR_DST_FMT_YCBCR422, 7 },
-	{ REN_RGB565, VTRCR_SRC_FMT_RGB565,   VTRCR_DST_FMT_RGB565,   6 },
-	{ REN_RGB24,  VTRCR_SRC_FMT_RGB888,   VTRCR_DST_FMT_RGB888,   7 },
-	{ REN_BGR24,  VTRCR_SRC_FMT_BGR888,   VTRCR_DST_FMT_BGR888,   7 },
-	{ REN_RGB32,  VTRCR_SRC_FMT_RGBX888,  VTRCR_DST_FMT_RGBX888,  4 },
+	[REN_NV12]	= { REN_NV12,   VTRCR_SRC_FMT_YCBCR420, VTRCR_DST_FMT_YCBCR420, 7 },
+	[REN_NV16]	= { REN_NV16,   VTRCR_SRC_FMT_YCBCR422, VTRCR_DST_FMT_YCBCR422, 7 },
+	[REN_RGB565]	= { REN_RGB565, VTRCR_SRC_FMT_RGB565,   VTRCR_DST_FMT_RGB565,   6 },
+	[REN_RGB24]	= { REN_RGB24,  VTRCR_SRC_FMT_RGB888,   VTRCR_DST_FMT_RGB888,   7 },
+	[REN_BGR24]	= { REN_BGR24,  VTRCR_SRC_FMT_BGR888,   VTRCR_DST_FMT_BGR888,   7 },
+	[REN_RGB32]	= { REN_RGB32,  VTRCR_SRC_FMT_RGBX888,  VTRCR_DST_FMT_RGBX888,  4 },
 };
 
+/* vio_fmts[] is indexed by format, unsupported formats have an empty entry */
 static const struct vio_format_info *fmt_info(ren_vid_format_t format)
 {
-	int i, nr_fmts;
-
-	nr_fmts = sizeof(vio_fmts) / sizeof(vio_fmts[0]);
-	for (i=0; i<nr_fmts; i++) {
-		if (vio_fmts[i].fmt == format)
-			return &vio_fmts[i];
-	}
-	return NULL;
+	if ((unsigned int)format >= sizeof(vio_fmts) / sizeof(vio_fmts[0]) ||
+	    vio_fmts[format].fmt == REN_UNKNOWN)
+		return NULL;
+	return &vio_fmts[format];
 }
 
+/* How long the VEU may take to stop before it is reset, and after */
+#define VEU_STOP_TIMEOUT_US	(100 * 1000)
+
 /* Helper functions for reading registers. */
 
 static uint32_t read_reg(void *base_addr, int reg_nr)
@@ -90,9 +89,7 @@ static uint32_t read_reg(void *base_addr, int reg_nr)
 	volatile uint32_t *reg = base_addr + reg_nr;
 	uint32_t value = *reg;
 
-#if (DEBUG == 2)
-	fprintf(stderr, " read_reg[0x%08x] returned 0x%08x\n", reg_nr, value);
-#endif
+	trace_reg(base_addr, reg_nr, value, 0);
 
 	return value;
 }
@@ -101,13 +98,22 @@ static void write_reg(void *base_addr, uint32_t value, int reg_nr)
 {
 	volatile uint32_t *reg = base_addr + reg_nr;
 
-#if (DEBUG == 2)
-	fprintf(stderr, " write_reg[0x%08x] = 0x%08x\n", reg_nr, value);
-#endif
+	trace_reg(base_addr, reg_nr, value, 1);
 
 	*reg = value;
 }
 
+/* The VEU is still running */
+static int veu_busy(SHVIO *vio)
+{
+	return read_reg(vio->uio_mmio.iomem, VESTR) & 1;
+}
+
+static int veu_format_supported(ren_vid_format_t format)
+{
+	return fmt_info(format) != NULL;
+}
+
 static int vio_is_veu2h(SHVIO *vio)
 {
 	/* Is this a VEU2H on SH7723? */
@@ -205,12 +211,20 @@ set_clip(void *base_addr, int vertical, int clip_out)
 	write_reg(base_addr, value, VRFSR);
 }
 
-static int format_supported(ren_vid_format_t fmt)
+/* The VEU2H can apply the correction matrix as part of YCbCr to RGB */
+static int
+veu_fuse_matrix(
+	SHVIO *vio,
+	const struct ren_vid_surface *src,
+	const struct ren_vid_surface *dst)
 {
-	const struct vio_format_info *info = fmt_info(fmt);
-	if (info)
-		return 1;
-	return 0;
+	int bt709, full_range;
+
+	if (!vio_is_veu2h(vio) || !is_ycbcr(src->format) || !is_rgb(dst->format))
+		return 0;
+
+	get_csc(vio, src, dst, &bt709, &full_range);
+	return matrix_fuse(&vio->matrix, bt709, full_range, NULL, NULL) == 0;
 }
 
 static int
@@ -226,6 +240,8 @@ veu_setup(
 	const struct vio_format_info *src_info;
 	const struct vio_format_info *dst_info;
 	void *base_addr;
+	int bt709, full_range;
+	struct timespec start;
 
 	src_info = fmt_info(src->format);
 	dst_info = fmt_info(dst->format);
@@ -234,7 +250,7 @@ veu_setup(
 	scale_x = (float)dst->w / src->w;
 	scale_y = (float)dst->h / src->h;
 
-	if (!format_supported(src->format) || !format_supported(dst->format)) {
+	if (!src_info || !dst_info) {
 		debug_info("ERR: Invalid surface format!");
 		return -1;
 	}
@@ -258,11 +274,21 @@ veu_setup(
 
 	base_addr = vio->uio_mmio.iomem;
 
+	stats_clock(vio, &start);
+
 	/* Software reset */
 	if (read_reg(base_addr, VESTR) & 0x1)
 		write_reg(base_addr, 0, VESTR);
-	while (read_reg(base_addr, VESTR) & 1)
-		;
+	if (poll_hw(vio, veu_busy, VEU_STOP_TIMEOUT_US) < 0) {
+		/* wedged, try to get it back with a module reset */
+		debug_info("ERR: VEU does not stop, resetting it");
+		vio->stats.recoveries++;
+		write_reg(base_addr, 0x100, VBSRR);
+		if (poll_hw(vio, veu_busy, VEU_STOP_TIMEOUT_US) < 0) {
+			debug_info("ERR: VEU does not stop after a reset");
+			return -1;
+		}
+	}
 
 	/* Clear VEU end interrupt flag */
 	write_reg(base_addr, 0, VEVTR);
@@ -270,20 +296,22 @@ veu_setup(
 	/* VEU Module reset */
 	write_reg(base_addr, 0x100, VBSRR);
 
+	stats_time(vio, SHVIO_PHASE_RESET, &start);
+
 	/* default to not using bundle mode */
 	write_reg(base_addr, 0, VBSSR);
 
 	/* source */
-	Y = uiomux_all_virt_to_phys(src->py);
-	C = uiomux_all_virt_to_phys(src->pc);
+	Y = vio_virt_to_phys(vio, src->py);
+	C = vio_virt_to_phys(vio, src->pc);
 	write_reg(base_addr, Y, VSAYR);
 	write_reg(base_addr, C, VSACR);
 	write_reg(base_addr, (src->h << 16) | src->w, VESSR);
 	write_reg(base_addr, size_y(src->format, src->pitch, src->bpitchy), VESWR);
 
 	/* destination */
-	Y = uiomux_all_virt_to_phys(dst->py);
-	C = uiomux_all_virt_to_phys(dst->pc);
+	Y = vio_virt_to_phys(vio, dst->py);
+	C = vio_virt_to_phys(vio, dst->pc);
 
 	if (filter_control & 0xFF) {
 		if ((filter_control & 0xFF) == 0x10) {
@@ -338,13 +366,23 @@ veu_setup(
 		temp |= VTRCR_RY_SRC_RGB;
 	if (different_colorspace(src->format, dst->format))
 		temp |= VTRCR_TE_BIT_SET;
-	if (vio->bt709)
+	get_csc(vio, src, dst, &bt709, &full_range);
+	if (bt709)
 		temp |= VTRCR_BT709;
-	if (vio->full_range)
+	if (full_range)
 		temp |= VTRCR_FULL_COLOR_CONV;
 	write_reg(base_addr, temp, VTRCR);
 
-	if (vio_is_veu2h(vio)) {
+	if (vio->matrix_hw) {
+		/* color conversion matrix merged with the correction matrix */
+		uint32_t vmcr[9], vcoffr;
+		int i;
+
+		matrix_fuse(&vio->matrix, bt709, full_range, vmcr, &vcoffr);
+		for (i = 0; i < 9; i++)
+			write_reg(base_addr, vmcr[i], VMCR00 + i * 4);
+		write_reg(base_addr, vcoffr, VCOFFR);
+	} else if (vio_is_veu2h(vio)) {
 		/* color conversion matrix */
 		write_reg(base_addr, 0x0cc5, VMCR00);
 		write_reg(base_addr, 0x0950, VMCR01);
@@ -389,8 +427,8 @@ veu_set_src(
 	void *base_addr = vio->uio_mmio.iomem;
 	uint32_t Y, C;
 
-	Y = uiomux_all_virt_to_phys(src_py);
-	C = uiomux_all_virt_to_phys(src_pc);
+	Y = vio_virt_to_phys(vio, src_py);
+	C = vio_virt_to_phys(vio, src_pc);
 	write_reg(base_addr, Y, VSAYR);
 	write_reg(base_addr, C, VSACR);
 }
@@ -416,8 +454,8 @@ veu_set_dst(
 	void *base_addr = vio->uio_mmio.iomem;
 	uint32_t Y, C;
 
-	Y = uiomux_all_virt_to_phys(dst_py);
-	C = uiomux_all_virt_to_phys(dst_pc);
+	Y = vio_virt_to_phys(vio, dst_py);
+	C = vio_virt_to_phys(vio, dst_pc);
 	write_reg(base_addr, Y, VDAYR);
 	write_reg(base_addr, C, VDACR);
 }
@@ -470,7 +508,12 @@ veu_wait(SHVIO *vio)
 	uint32_t vstar;
 	int complete = 0;
 
-	vevtr = read_reg(base_addr, VEVTR);
+	/* sleep until the end of the frame, or of a bundle */
+	wait_irq(vio);
+	while (((vevtr = read_reg(base_addr, VEVTR)) & 0x101) == 0) {
+		vio->stats.spurious_wakeups++;
+		wait_irq(vio);
+	}
 	write_reg(base_addr, 0, VEVTR);   /* ack interrupts */
 
 	/* End of VEU operation? */
@@ -479,6 +522,13 @@ veu_wait(SHVIO *vio)
 	return complete;
 }
 
+static int
+veu_done_reg(SHVIO *vio, uint32_t *mask)
+{
+	*mask = 0x101;
+	return VEVTR;
+}
+
 const struct shvio_operations veu_ops = {
 	.setup = veu_setup,
 	.set_src = veu_set_src,
@@ -488,4 +538,7 @@ const struct shvio_operations veu_ops = {
 	.start = veu_start,
 	.start_bundle = veu_start_bundle,
 	.wait = veu_wait,
+	.done_reg = veu_done_reg,
+	.fuse_matrix = veu_fuse_matrix,
+	.format_supported = veu_format_supported,
 };
@@ -32,6 +32,7 @@
 #include "vio6_regs.h"
 
 #include "common.h"
+#include "probes.h"
 
 #include <endian.h>
 
@@ -46,6 +47,7 @@
 #endif
 
 #define VIO6_NUM_ENTITIES	(5 + 4 + 2 + 1 + 1)
+#define VIO6_RESET_TIMEOUT_US	(10 * 1000)	/* as long as a WPF reset may take */
 
 static struct shvio_entity vio6_ent[] = {
 	/* RPF */
@@ -55,7 +57,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	0,
 		.dpr_shift	=	24,
 		.funcs	=	SHVIO_FUNC_SRC | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	1,
@@ -63,7 +64,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	0,
 		.dpr_shift	=	16,
 		.funcs	=	SHVIO_FUNC_SRC | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	2,
@@ -71,7 +71,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	0,
 		.dpr_shift	=	8,
 		.funcs	=	SHVIO_FUNC_SRC | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	3,
@@ -79,7 +78,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	0,
 		.dpr_shift	=	0,
 		.funcs	=	SHVIO_FUNC_SRC | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	4,
@@ -87,7 +85,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	1,
 		.dpr_shift	=	24,
 		.funcs	=	SHVIO_FUNC_SRC | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	/* WPF */
 	{
@@ -96,7 +93,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	-1,
 		.dpr_shift	=	-1,
 		.funcs	=	SHVIO_FUNC_SINK | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	1,
@@ -104,7 +100,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	-1,
 		.dpr_shift	=	-1,
 		.funcs	=	SHVIO_FUNC_SINK | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	2,
@@ -112,7 +107,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	-1,
 		.dpr_shift	=	-1,
 		.funcs	=	SHVIO_FUNC_SINK | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	3,
@@ -120,7 +114,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	-1,
 		.dpr_shift	=	-1,
 		.funcs	=	SHVIO_FUNC_SINK | SHVIO_FUNC_CSC,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	/* UDS */
 	{
@@ -129,7 +122,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	1,
 		.dpr_shift	=	8,
 		.funcs	=	SHVIO_FUNC_SCALE | SHVIO_FUNC_CROP,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	{
 		.idx	=	1,
@@ -137,7 +129,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	3,
 		.dpr_shift	=	8,
 		.funcs	=	SHVIO_FUNC_SCALE | SHVIO_FUNC_CROP,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	/* LUT */
 	{
@@ -146,7 +137,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	2,
 		.dpr_shift	=	16,
 		.funcs	=	SHVIO_FUNC_EFFECT,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 	/* BRU */
 	{
@@ -155,7 +145,6 @@ static struct shvio_entity vio6_ent[] = {
 		.dpr_ctrl	=	3,
 		.dpr_shift	=	16,
 		.funcs	=	SHVIO_FUNC_BLEND,
-		.lock	=	PTHREAD_MUTEX_INITIALIZER,
 	},
 };
 
@@ -166,35 +155,35 @@ struct vio_format_info {
 };
 
 static const struct vio_format_info vio_fmts[] = {
-	{ REN_NV12,	FMT_YCBCR420SP,	0xf },
-	{ REN_NV16,	FMT_YCBCR422SP,	0xf },
-	{ REN_YV12,	FMT_YCBCR420P,	0xf },
-	{ REN_YV16,	FMT_YCBCR422P,	0xf },
-	{ REN_UYVY,	FMT_YCBCR422I,	0xf },
-	{ REN_XRGB1555,	FMT_XRGB1555,	0xe },
-	{ REN_RGB565,	FMT_RGB565,	0xe },
-	{ REN_RGB24,	FMT_RGB888,	0xf },
-	{ REN_BGR24,	FMT_BGR888,	0xf },
-	{ REN_RGB32,	FMT_RGBX888,	0xc },
-	{ REN_BGR32,	FMT_RGBX888,	0xf },
-	{ REN_BGRA32,	FMT_RGBX888,	0xf },
-	{ REN_XRGB32,	FMT_ARGB8888,	0xc },
-	{ REN_ARGB32,	FMT_ARGB8888,	0xc },
+	[REN_NV12]	= { REN_NV12,	FMT_YCBCR420SP,	0xf },
+	[REN_NV16]	= { REN_NV16,	FMT_YCBCR422SP,	0xf },
+	[REN_YV12]	= { REN_YV12,	FMT_YCBCR420P,	0xf },
+	[REN_YV16]	= { REN_YV16,	FMT_YCBCR422P,	0xf },
+	[REN_UYVY]	= { REN_UYVY,	FMT_YCBCR422I,	0xf },
+	[REN_XRGB1555]	= { REN_XRGB1555,	FMT_XRGB1555,	0xe },
+	[REN_RGB565]	= { REN_RGB565,	FMT_RGB565,	0xe },
+	[REN_RGB24]	= { REN_RGB24,	FMT_RGB888,	0xf },
+	[REN_BGR24]	= { REN_BGR24,	FMT_BGR888,	0xf },
+	[REN_RGB32]	= { REN_RGB32,	FMT_RGBX888,	0xc },
+	[REN_BGR32]	= { REN_BGR32,	FMT_RGBX888,	0xf },
+	[REN_BGRA32]	= { REN_BGRA32,	FMT_RGBX888,	0xf },
+	[REN_XRGB32]	= { REN_XRGB32,	FMT_ARGB8888,	0xc },
+	[REN_ARGB32]	= { REN_ARGB32,	FMT_ARGB8888,	0xc },
+	[REN_NV21]	= { REN_NV21,	FMT_YCBCR420SP | FMT_SPUVS,	0xf },
+	[REN_YUYV]	= { REN_YUYV,	FMT_YCBCR422I | FMT_SPYCS,	0xf },
+	[REN_YVYU]	= { REN_YVYU,	FMT_YCBCR422I | FMT_SPYCS | FMT_SPUVS,	0xf },
+	[REN_VYUY]	= { REN_VYUY,	FMT_YCBCR422I | FMT_SPUVS,	0xf },
 };
 
+/* vio_fmts[] is indexed by format, unsupported formats have an empty entry */
 static const struct vio_format_info *fmt_info(ren_vid_format_t format)
 {
-	int i, nr_fmts;
-
-	nr_fmts = sizeof(vio_fmts) / sizeof(vio_fmts[0]);
-	for (i=0; i<nr_fmts; i++) {
-		if (vio_fmts[i].fmt == format)
-			return &vio_fmts[i];
-	}
-	return NULL;
+	if ((unsigned int)format >= sizeof(vio_fmts) / sizeof(vio_fmts[0]) ||
+	    vio_fmts[format].fmt == REN_UNKNOWN)
+		return NULL;
+	return &vio_fmts[format];
 }
 
-#if (DEBUG == 2)
 static const char *regname_misc[] = {
 	[0x00000000] = "CMD0",
 	[0x00000004] = "CMD1",
@@ -279,54 +268,51 @@ static const char *regname_bru[] = {
 	[0x00000030] = "ROP",
 };
 
-static inline void show_regname(int reg_nr)
+#define REGNAMES(names)	names, sizeof(names) / sizeof(names[0])
+
+static const struct {
+	int base;
+	const char *prefix;
+	const char **names;
+	int n;
+} regname_blocks[] = {
+	{ 0x0000, "",      REGNAMES(regname_misc) },
+	{ 0x0300, "RPF0_", REGNAMES(regname_rpf) },
+	{ 0x0400, "RPF1_", REGNAMES(regname_rpf) },
+	{ 0x0500, "RPF2_", REGNAMES(regname_rpf) },
+	{ 0x0600, "RPF3_", REGNAMES(regname_rpf) },
+	{ 0x0700, "RPF4_", REGNAMES(regname_rpf) },
+	{ 0x1000, "WPF0_", REGNAMES(regname_wpf) },
+	{ 0x1100, "WPF1_", REGNAMES(regname_wpf) },
+	{ 0x1200, "WPF2_", REGNAMES(regname_wpf) },
+	{ 0x1300, "WPF3_", REGNAMES(regname_wpf) },
+	{ 0x2000, "",      REGNAMES(regname_dpr) },
+	{ 0x2300, "UDS0_", REGNAMES(regname_uds) },
+	{ 0x2a00, "BRU_",  REGNAMES(regname_bru) },
+	{ 0x2b00, "UDS1_", REGNAMES(regname_uds) },
+};
+
+/* Name of a register, for the register access trace */
+static void vio6_reg_name(int reg_nr, char *buf, size_t len)
 {
-	if (reg_nr < 0x300)
-		fprintf(stderr, "%-20s", regname_misc[reg_nr]);
-	else if (reg_nr < 0x300)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr < 0x400)
-		fprintf(stderr, "RPF0_%-15s", regname_rpf[reg_nr - 0x300]);
-	else if (reg_nr < 0x500)
-		fprintf(stderr, "RPF1_%-15s", regname_rpf[reg_nr - 0x400]);
-	else if (reg_nr < 0x600)
-		fprintf(stderr, "RPF2_%-15s", regname_rpf[reg_nr - 0x500]);
-	else if (reg_nr < 0x700)
-		fprintf(stderr, "RPF3_%-15s", regname_rpf[reg_nr - 0x600]);
-	else if (reg_nr < 0x800)
-		fprintf(stderr, "RPF4_%-15s", regname_rpf[reg_nr - 0x700]);
-	else if (reg_nr < 0x1000)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr < 0x1100)
-		fprintf(stderr, "WPF0_%-15s", regname_wpf[reg_nr - 0x1000]);
-	else if (reg_nr < 0x1200)
-		fprintf(stderr, "WPF1_%-15s", regname_wpf[reg_nr - 0x1100]);
-	else if (reg_nr < 0x1300)
-		fprintf(stderr, "WPF2_%-15s", regname_wpf[reg_nr - 0x1200]);
-	else if (reg_nr < 0x1400)
-		fprintf(stderr, "WPF3_%-15s", regname_wpf[reg_nr - 0x1300]);
-	else if (reg_nr < 0x2000)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr <= 0x2024)
-		fprintf(stderr, "DPR_%-16s", regname_dpr[reg_nr - 0x2000]);
-	else if (reg_nr < 0x2300)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr <= 0x2328)
-		fprintf(stderr, "UDS0_%-15s", regname_uds[reg_nr - 0x2300]);
-	else if (reg_nr < 0x2600)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr == 0x2600)
-		fprintf(stderr, "LUT                ");
-	else if (reg_nr < 0x2a00)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr <= 0x2a30)
-		fprintf(stderr, "BRU_%-16s", regname_bru[reg_nr - 0x2a00]);
-	else if (reg_nr < 0x2b00)
-		fprintf(stderr, "UNKNOWN (0x%04x)   ", reg_nr);
-	else if (reg_nr <= 0x2b28)
-		fprintf(stderr, "UDS1_%-15s", regname_uds[reg_nr - 0x2b00]);
+	int n = sizeof(regname_blocks) / sizeof(regname_blocks[0]);
+	int i, off;
+
+	for (i = 0; i < n; i++) {
+		off = reg_nr - regname_blocks[i].base;
+		if (off >= 0 && off < regname_blocks[i].n &&
+		    regname_blocks[i].names[off]) {
+			snprintf(buf, len, "%s%s", regname_blocks[i].prefix,
+				 regname_blocks[i].names[off]);
+			return;
+		}
+	}
+
+	if (reg_nr == 0x2600)
+		snprintf(buf, len, "LUT");
+	else
+		snprintf(buf, len, "UNKNOWN (0x%04x)", reg_nr);
 }
-#endif
 
 /* Helper functions for reading registers. */
 
@@ -335,12 +321,7 @@ static uint32_t read_reg(void *base_addr, int reg_nr)
 	volatile uint32_t *reg = base_addr + reg_nr;
 	uint32_t value = *reg;
 
-#if (DEBUG == 2)
-	fprintf(stderr, "  read_reg[");
-	show_regname(reg_nr);
-	fprintf(stderr, "] returned 0x%08x\n", value);
-	fflush(stderr);
-#endif
+	trace_reg(base_addr, reg_nr, value, 0);
 
 	return value;
 }
@@ -349,12 +330,7 @@ static void write_reg(void *base_addr, uint32_t value, int reg_nr)
 {
 	volatile uint32_t *reg = base_addr + reg_nr;
 
-#if (DEBUG == 2)
-	fprintf(stderr, " write_reg[");
-	show_regname(reg_nr);
-	fprintf(stderr, "] = 0x%08x\n", value);
-	fflush(stderr);
-#endif
+	trace_reg(base_addr, reg_nr, value, 1);
 
 	*reg = value;
 }
@@ -418,10 +394,7 @@ static void set_scale(void *base_addr, int id, int vertical,
 
 static int format_supported(ren_vid_format_t fmt)
 {
-	const struct vio_format_info *info = fmt_info(fmt);
-	if (info)
-		return 1;
-	return 0;
+	return fmt_info(fmt) != NULL;
 }
 
 static void
@@ -445,16 +418,10 @@ vio6_set_src(
 		return;
 	}
 
-	if (vio->src_hw.py != vio->src_user.py) {
-		size_t len = size_y(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		len += size_c(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->src_hw.py, len);
-	}
-
-	Y = uiomux_all_virt_to_phys(src_py);
+	Y = vio_virt_to_phys(vio, src_py);
 	write_reg(base_addr, Y, RPF_SRCM_ADDR_Y(entity->idx));
 	vio->src_hw.py = vio->src_user.py = src_py;
-	C = uiomux_all_virt_to_phys(src_pc);
+	C = vio_virt_to_phys(vio, src_pc);
 	write_reg(base_addr, C, RPF_SRCM_ADDR_C0(entity->idx));
 	vio->src_hw.pc = vio->src_user.pc = src_pc;
 }
@@ -481,19 +448,13 @@ vio6_set_src2(
 		return;
 	}
 
-	if (vio->src_hw.py != vio->src_user.py) {
-		size_t len = size_y(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		len += size_c(vio->src_hw.format, vio->src_hw.h * vio->src_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->src_hw.py, len);
-	}
-
-	Y = uiomux_all_virt_to_phys(src_py);
+	Y = vio_virt_to_phys(vio, src_py);
 	write_reg(base_addr, Y, RPF_SRCM_ADDR_Y(entity->idx));
 	vio->src_hw.py = vio->src_user.py = src_py;
-	Cb = uiomux_all_virt_to_phys(src_pcb);
+	Cb = vio_virt_to_phys(vio, src_pcb);
 	write_reg(base_addr, Cb, RPF_SRCM_ADDR_C0(entity->idx));
 	vio->src_hw.pc = vio->src_user.pc = src_pcb;
-	Cr = uiomux_all_virt_to_phys(src_pcr);
+	Cr = vio_virt_to_phys(vio, src_pcr);
 	write_reg(base_addr, Cr, RPF_SRCM_ADDR_C1(entity->idx));
 	vio->src_hw.pc2 = vio->src_user.pc2 = src_pcr;
 }
@@ -523,6 +484,21 @@ vio6_set_src_phys(
 	/* We do not update values in the 'src_hw' and 'src_user' */
 }
 
+/* Program the destination addresses. A copy is kept so that the addresses
+   of the next stripe can be worked out without reading the registers back */
+static void
+vio6_wpf_set_addr(SHVIO *vio, struct shvio_entity *entity,
+		  ren_vid_format_t format, const uint32_t addr[3])
+{
+	void *base_addr = vio->uio_mmio.iomem;
+
+	write_reg(base_addr, addr[0], WPF_DSTM_ADDR_Y(entity->idx));
+	write_reg(base_addr, addr[1], WPF_DSTM_ADDR_C0(entity->idx));
+	if (is_ycbcr_planar(format))
+		write_reg(base_addr, addr[2], WPF_DSTM_ADDR_C1(entity->idx));
+	memcpy(vio->dst_addr, addr, sizeof(vio->dst_addr));
+}
+
 static void
 vio6_set_dst(
 	SHVIO *vio,
@@ -530,24 +506,17 @@ vio6_set_dst(
 	void *dst_pc)
 {
 	struct shvio_entity *entity = vio->sink_entity;
-	void *base_addr = vio->uio_mmio.iomem;
-	uint32_t Y, C;
+	uint32_t addr[3];
 
 	if (entity == NULL)
 		return;
 
-	if (vio->dst_hw.py != vio->dst_user.py) {
-		size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
-	}
-
-	Y = uiomux_all_virt_to_phys(dst_py);
-	write_reg(base_addr, Y, WPF_DSTM_ADDR_Y(entity->idx));
+	addr[0] = vio_virt_to_phys(vio, dst_py);
 	vio->dst_hw.py = vio->dst_user.py = dst_py;
-	C = uiomux_all_virt_to_phys(dst_pc);
-	write_reg(base_addr, C, WPF_DSTM_ADDR_C0(entity->idx));
+	addr[1] = vio_virt_to_phys(vio, dst_pc);
 	vio->dst_hw.pc = vio->dst_user.pc = dst_pc;
+	addr[2] = vio->dst_addr[2];
+	vio6_wpf_set_addr(vio, entity, vio->dst_hw.format, addr);
 }
 
 static void
@@ -558,27 +527,18 @@ vio6_set_dst2(
 	void *dst_pcr)
 {
 	struct shvio_entity *entity = vio->sink_entity;
-	void *base_addr = vio->uio_mmio.iomem;
-	uint32_t Y, Cb, Cr;
+	uint32_t addr[3];
 
 	if (entity == NULL)
 		return;
 
-	if (vio->dst_hw.py != vio->dst_user.py) {
-		size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
-	}
-
-	Y = uiomux_all_virt_to_phys(dst_py);
-	write_reg(base_addr, Y, WPF_DSTM_ADDR_Y(entity->idx));
+	addr[0] = vio_virt_to_phys(vio, dst_py);
 	vio->dst_hw.py = vio->dst_user.py = dst_py;
-	Cb = uiomux_all_virt_to_phys(dst_pcb);
-	write_reg(base_addr, Cb, WPF_DSTM_ADDR_C0(entity->idx));
+	addr[1] = vio_virt_to_phys(vio, dst_pcb);
 	vio->dst_hw.pc = vio->dst_user.pc = dst_pcb;
-	Cr = uiomux_all_virt_to_phys(dst_pcr);
-	write_reg(base_addr, Cr, WPF_DSTM_ADDR_C1(entity->idx));
+	addr[2] = vio_virt_to_phys(vio, dst_pcr);
 	vio->dst_hw.pc2 = vio->dst_user.pc2 = dst_pcr;
+	vio6_wpf_set_addr(vio, entity, vio->dst_hw.format, addr);
 }
 
 static void
@@ -588,31 +548,33 @@ vio6_set_dst_phys(
 	uint32_t dst_pc)
 {
 	struct shvio_entity *entity = vio->sink_entity;
-	void *base_addr = vio->uio_mmio.iomem;
+	uint32_t addr[3];
 
 	if (entity == NULL)
 		return;
 
-	if (vio->dst_hw.py != vio->dst_user.py) {
-		size_t len = size_y(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		len += size_c(vio->dst_hw.format, vio->dst_hw.h * vio->dst_hw.w, 0);
-		uiomux_free(vio->uiomux, vio->uiores, vio->dst_hw.py, len);
-	}
-
-	write_reg(base_addr, dst_py, WPF_DSTM_ADDR_Y(entity->idx));
-	write_reg(base_addr, dst_pc, WPF_DSTM_ADDR_C0(entity->idx));
+	addr[0] = dst_py;
+	addr[1] = dst_pc;
+	addr[2] = vio->dst_addr[2];
+	vio6_wpf_set_addr(vio, entity, vio->dst_hw.format, addr);
 	/* We do not update values in the 'dst_hw' and 'dst_user' */
 }
 
+/* The reset of the WPF has not completed */
+static int
+vio6_resetting(SHVIO *vio)
+{
+	void *base_addr = vio->uio_mmio.iomem;
+
+	return read_reg(base_addr, WPF_IRQ_STA(vio->sink_entity->idx)) == 0;
+}
+
 static void
 vio6_reset(SHVIO *vio)
 {
 	struct shvio_entity *entity = vio->sink_entity;
 	void *base_addr = vio->uio_mmio.iomem;
-	const struct timespec timeout = {
-		.tv_sec = 0,
-		.tv_nsec = 1000 * 1000,
-	};
+	struct timespec start;
 	uint32_t val;
 	int i;
 
@@ -621,6 +583,8 @@ vio6_reset(SHVIO *vio)
 		return;
 	}
 
+	stats_clock(vio, &start);
+
 	base_addr = vio->uio_mmio.iomem;
 
 	/* WPF: disable interrupt */
@@ -629,15 +593,14 @@ vio6_reset(SHVIO *vio)
 	/* WPF: software reset */
 	if (read_reg(base_addr, STATUS) & (1 << entity->idx)) {
 		write_reg(base_addr, 1 << entity->idx, SRESET);
-		for (i=0; i<10; i++) {
-			if (read_reg(base_addr, WPF_IRQ_STA(entity->idx)) != 0)
-				break;
-			nanosleep(&timeout, NULL);	/* wait 1ms */
+		if (poll_hw(vio, vio6_resetting, VIO6_RESET_TIMEOUT_US) < 0) {
+			debug_info("ERR: WPF reset timed out");
 		}
 		write_reg(base_addr, 0, WPF_IRQ_STA(entity->idx));
 	}
 
 	/* DPR: set the termination for routing registers */
+	entity_hw_lock();
 	for (i=VIO6_NUM_ENTITIES-1; i>=0; i--) {
 		if (vio6_ent[i].dpr_ctrl < 0)
 			continue;
@@ -653,6 +616,9 @@ vio6_reset(SHVIO *vio)
 	write_reg(base_addr, 0, DPR_FPORCH(1));
 	write_reg(base_addr, (5 << 16) | (5 << 8) | 5, DPR_FPORCH(2));
 	write_reg(base_addr, 5 << 24, DPR_FPORCH(3));
+	entity_hw_unlock();
+
+	stats_time(vio, SHVIO_PHASE_RESET, &start);
 }
 
 static void
@@ -664,14 +630,16 @@ vio6_rpf_setup(SHVIO *vio, struct shvio_entity *entity,
 	const struct vio_format_info *viofmt;
 	uint32_t val;
 	uint32_t Y, Cb;
+	int bt709, full_range;
 
 	viofmt = fmt_info(src->format);
 	val = viofmt->fmtid;
 	if (is_ycbcr(src->format) == is_rgb(dst->format)) {
+		get_csc(vio, src, dst, &bt709, &full_range);
 		val |= FMT_DO_CSC;
-		if (vio->bt709)
+		if (bt709)
 			val |= FMT_WRTM_BT709;
-		if (vio->full_range)
+		if (full_range)
 			val |= FMT_WRTM_FULL_RANGE;
 	}
 	write_reg(base_addr, val, RPF_INFMT(entity->idx));
@@ -682,13 +650,13 @@ vio6_rpf_setup(SHVIO *vio, struct shvio_entity *entity,
 #endif
 
 	/* RPF: source setting */
-	Y = uiomux_all_virt_to_phys(src->py);
+	Y = vio_virt_to_phys(vio, src->py);
 	write_reg(base_addr, Y, RPF_SRCM_ADDR_Y(entity->idx));
-	Cb = uiomux_all_virt_to_phys(src->pc);
+	Cb = vio_virt_to_phys(vio, src->pc);
 	write_reg(base_addr, Cb, RPF_SRCM_ADDR_C0(entity->idx));
 	if (is_ycbcr_planar(src->format)) {
 		uint32_t Cr;
-		Cr = uiomux_all_virt_to_phys(src->pc2);
+		Cr = vio_virt_to_phys(vio, src->pc2);
 		write_reg(base_addr, Cr, RPF_SRCM_ADDR_C1(entity->idx));
 	}
 	write_reg(base_addr, (src->blend_out.x << 16) | src->blend_out.y, RPF_LOC(entity->idx));
@@ -697,8 +665,13 @@ vio6_rpf_setup(SHVIO *vio, struct shvio_entity *entity,
 	else
 		write_reg(base_addr, 4 << 28, RPF_ALPH_SEL(entity->idx));
 	write_reg(base_addr, 0xff << 24, RPF_VRTCOL_SET(entity->idx));
-	/* RPF_MSKCTRL, RPF_MSKSET0, RPF_MSKSET1,
-	   RPF_CKEY_CTRL, RPF_CKEY_SET0, RPF_CKEY_SET1 */
+	/* The mask is an IROP pixel mask, not a window. Windowed input is
+	   done by vio6_get_window() trimming the addresses and sizes, so
+	   make sure no stale mask from a previous user is left enabled */
+	write_reg(base_addr, 0, RPF_MSKCTRL(entity->idx));
+	write_reg(base_addr, 0, RPF_MSKSET0(entity->idx));
+	write_reg(base_addr, 0, RPF_MSKSET1(entity->idx));
+	/* RPF_CKEY_CTRL, RPF_CKEY_SET0, RPF_CKEY_SET1 */
 	write_reg(base_addr, (src->w << 16) | src->h, RPF_SRC_BSIZE(entity->idx));
 	write_reg(base_addr, (src->w << 16) | src->h, RPF_SRC_ESIZE(entity->idx));
 	vio->bundle_remaining_lines = src->h;
@@ -760,18 +733,15 @@ vio6_wpf_setup(SHVIO *vio, struct shvio_entity *entity,
 	void *base_addr = vio->uio_mmio.iomem;
 	const struct vio_format_info *viofmt;
 	uint32_t val;
-	uint32_t Y, Cb;
+	uint32_t addr[3];
+	int bt709, full_range;
 
 	/* WPF: destination setting */
-	Y = uiomux_all_virt_to_phys(dst->py);
-	write_reg(base_addr, Y, WPF_DSTM_ADDR_Y(entity->idx));
-	Cb = uiomux_all_virt_to_phys(dst->pc);
-	write_reg(base_addr, Cb, WPF_DSTM_ADDR_C0(entity->idx));
-	if (is_ycbcr_planar(dst->format)) {
-		uint32_t Cr;
-		Cr = uiomux_all_virt_to_phys(dst->pc2);
-		write_reg(base_addr, Cr, WPF_DSTM_ADDR_C1(entity->idx));
-	}
+	addr[0] = vio_virt_to_phys(vio, dst->py);
+	addr[1] = vio_virt_to_phys(vio, dst->pc);
+	addr[2] = is_ycbcr_planar(dst->format) ?
+		vio_virt_to_phys(vio, dst->pc2) : 0;
+	vio6_wpf_set_addr(vio, entity, dst->format, addr);
 
 	val = 0;
 	rpfact(entity, &val);
@@ -803,10 +773,11 @@ vio6_wpf_setup(SHVIO *vio, struct shvio_entity *entity,
 	viofmt = fmt_info(dst->format);
 	val = viofmt->fmtid;
 	if (is_ycbcr(src->format) == is_rgb(dst->format)) {
+		get_csc(vio, src, dst, &bt709, &full_range);
 		val |= FMT_DO_CSC;
-		if (vio->bt709)
+		if (bt709)
 			val |= FMT_WRTM_BT709;
-		if (vio->full_range)
+		if (full_range)
 			val |= FMT_WRTM_FULL_RANGE;
 	}
 	val |= FMT_PXA_DPR;	/* fill PAD with alpha value
@@ -848,6 +819,53 @@ vio6_uds_setup(SHVIO *vio, struct shvio_entity *entity,
 
 }
 
+/* Restrict a blend source to its visible window. The RPF then only fetches
+   the window, and the window is placed where it would appear in blend_out */
+static int
+vio6_get_window(struct ren_vid_surface *out, const struct ren_vid_surface *in)
+{
+	struct ren_vid_rect win;
+	int hinc = horz_increment(in->format);
+	int vinc = vert_increment(in->format);
+	int x1, y1;
+
+	*out = *in;
+	if (in->window.w <= 0 || in->window.h <= 0)
+		return 0;
+
+	/* clip to the surface, growing to the chroma sub-sampling grid */
+	win.x = (in->window.x < 0) ? 0 : in->window.x;
+	win.y = (in->window.y < 0) ? 0 : in->window.y;
+	x1 = in->window.x + in->window.w;
+	y1 = in->window.y + in->window.h;
+	if (x1 > in->w)
+		x1 = in->w;
+	if (y1 > in->h)
+		y1 = in->h;
+	win.x &= ~(hinc - 1);
+	win.y &= ~(vinc - 1);
+	x1 = (x1 + hinc - 1) & ~(hinc - 1);
+	y1 = (y1 + vinc - 1) & ~(vinc - 1);
+	win.w = x1 - win.x;
+	win.h = y1 - win.y;
+
+	if (win.w <= 0 || win.h <= 0) {
+		debug_info("ERR: window is outside the surface");
+		return -1;
+	}
+
+	get_sel_surface(out, in, &win);
+
+	/* keep the scaling ratio of the whole surface */
+	out->blend_out.x = in->blend_out.x + win.x * in->blend_out.w / in->w;
+	out->blend_out.y = in->blend_out.y + win.y * in->blend_out.h / in->h;
+	out->blend_out.w = out->w * in->blend_out.w / in->w;
+	out->blend_out.h = out->h * in->blend_out.h / in->h;
+	out->window.w = out->window.h = 0;
+
+	return 0;
+}
+
 static void
 vio6_bru_setup(SHVIO *vio, struct shvio_entity *entity,
 	       const struct ren_vid_rect *virt,
@@ -925,6 +943,7 @@ vio6_unlink(SHVIO *vio, struct shvio_entity *entity)
 	uint32_t val;
 	int i;
 
+	entity_hw_lock();
 	if (entity->pad_out != NULL) {
 		for (i=0; i<N_INPADS; i++) {
 			if (entity->pad_out->pad_in[i] == entity) {
@@ -949,6 +968,7 @@ vio6_unlink(SHVIO *vio, struct shvio_entity *entity)
 			write_reg(base_addr, val, DPR_CTRL(prev_entity->dpr_ctrl));
 		}
 	}
+	entity_hw_unlock();
 }
 
 static int
@@ -964,13 +984,17 @@ vio6_link(SHVIO *vio, struct shvio_entity *src, struct shvio_entity *sink, int s
 		return -1;
 	}
 
+	/* routing registers are shared with other entities' users */
+	entity_hw_lock();
 	val = read_reg(base_addr, DPR_CTRL(src->dpr_ctrl));
 	val &= ~(0x1f << src->dpr_shift);
 	val |= (sink->dpr_target + sinkpad) << src->dpr_shift;
 	write_reg(base_addr, val, DPR_CTRL(src->dpr_ctrl));
+	entity_hw_unlock();
 
 	sink->pad_in[sinkpad] = src;
 	src->pad_out = sink;
+	PROBE5(link, vio, src - vio6_ent, sink - vio6_ent, sinkpad);
 
 	return 0;
 }
@@ -990,34 +1014,51 @@ vio6_unlock(SHVIO *vio, struct shvio_entity *entity)
 	if (vio->locked_entities == entity)
 		vio->locked_entities = entity->list_next;
 
-	pthread_mutex_unlock(&entity->lock);
+	entity_free(vio6_ent, entity);
 }
 
-static struct shvio_entity *
-vio6_lock(SHVIO *vio, int func)
+static void
+vio6_unlock_all(SHVIO *vio)
 {
-	struct shvio_entity *ent;
-	int i;
+	while (vio->locked_entities != NULL)
+		vio6_unlock(vio, vio->locked_entities);
+	vio->sink_entity = NULL;
+}
+
+/* Take an entity for each of the functions, all of them or none */
+static int
+vio6_lock(SHVIO *vio, const int *funcs, int n, struct shvio_entity **ents)
+{
+	struct timespec start;
+	uint32_t mask = 0;
 	int ret;
+	int i;
 
-	for (i=0; i<VIO6_NUM_ENTITIES; i++) {
-		if (vio6_ent[i].funcs & func) {
-			ret = pthread_mutex_trylock(&vio6_ent[i].lock);
-			if (ret != 0)
-				continue;
-			memset(vio6_ent[i].pad_in, 0, sizeof(struct shvio_entity *) * N_INPADS);
-			vio6_ent[i].pad_out = NULL;
-			vio6_ent[i].list_prev = NULL;
-			vio6_ent[i].list_next = vio->locked_entities;
-			if (vio->locked_entities)
-				vio->locked_entities->list_prev = &vio6_ent[i];
-			vio->locked_entities = &vio6_ent[i];
-			return &vio6_ent[i];
-		}
+	/* give back anything left over from a previous operation */
+	vio6_unlock_all(vio);
+
+	/* the device is shared, so this is where an operation waits for it */
+	stats_clock(vio, &start);
+	ret = entity_alloc(vio, vio6_ent, VIO6_NUM_ENTITIES, funcs, n, ents);
+	vio->lock_us += stats_time(vio, SHVIO_PHASE_LOCK, &start);
+	if (ret < 0)
+		return -1;
+
+	for (i = 0; i < n; i++) {
+		struct shvio_entity *ent = ents[i];
+
+		memset(ent->pad_in, 0, sizeof(struct shvio_entity *) * N_INPADS);
+		ent->pad_out = NULL;
+		ent->list_prev = NULL;
+		ent->list_next = vio->locked_entities;
+		if (vio->locked_entities)
+			vio->locked_entities->list_prev = ent;
+		vio->locked_entities = ent;
+		mask |= 1 << (ent - vio6_ent);
 	}
+	PROBE3(entity_lock, vio, mask);
 
-	debug_info("LOG: no entity found");
-	return NULL;
+	return 0;
 }
 
 static int
@@ -1026,8 +1067,9 @@ vio6_fill(
 	const struct ren_vid_surface *dst,
 	uint32_t argb)
 {
+	static const int funcs[] = { SHVIO_FUNC_SRC, SHVIO_FUNC_SINK };
 	void *base_addr;
-	struct shvio_entity *ent_src, *ent_sink;
+	struct shvio_entity *ents[2], *ent_src, *ent_sink;
 	struct ren_vid_surface vsrc = *dst;
 	int ret;
 
@@ -1036,13 +1078,12 @@ vio6_fill(
 		return -1;
 	}
 
-	ent_src = vio6_lock(vio, SHVIO_FUNC_SRC);
-	ent_sink = vio6_lock(vio, SHVIO_FUNC_SINK);
-
-	if ((ent_src == NULL) || (ent_sink == NULL)) {
-		debug_info("ERR: No entity unavailable!");
-		goto fail_lock_entities;
+	if (vio6_lock(vio, funcs, 2, ents) < 0) {
+		debug_info("ERR: No entity available!");
+		return -1;
 	}
+	ent_src = ents[0];
+	ent_sink = ents[1];
 
 	vio->sink_entity = ent_sink;
 	vio6_reset(vio);
@@ -1058,10 +1099,7 @@ vio6_fill(
 
 	return 0;
 fail_link_entities:
-fail_lock_entities:
-	while (vio->locked_entities != NULL)
-		vio6_unlock(vio, vio->locked_entities);
-	vio->sink_entity = NULL;
+	vio6_unlock_all(vio);
 	return -1;
 }
 
@@ -1078,26 +1116,27 @@ vio6_setup(
 	const struct vio_format_info *dst_info;
 	uint32_t val;
 	void *base_addr;
-	struct shvio_entity *ent_src, *ent_scale, *ent_sink;
+	static const int funcs[] = {
+		SHVIO_FUNC_SRC, SHVIO_FUNC_SCALE, SHVIO_FUNC_SINK
+	};
+	struct shvio_entity *ents[3], *ent_src, *ent_scale, *ent_sink;
 	int ret;
 
 	src_info = fmt_info(src->format);
 	dst_info = fmt_info(dst->format);
 
-	if (!format_supported(src->format) ||
-	    !format_supported(dst->format)) {
+	if (!src_info || !dst_info) {
 		debug_info("ERR: Invalid surface format!");
 		return -1;
 	}
 
-	ent_src = vio6_lock(vio, SHVIO_FUNC_SRC);
-	ent_scale = vio6_lock(vio, SHVIO_FUNC_SCALE);
-	ent_sink = vio6_lock(vio, SHVIO_FUNC_SINK);
-
-	if ((ent_src == NULL) || (ent_scale == NULL) || (ent_sink == NULL)) {
-		debug_info("ERR: No entity unavailable!");
-		goto fail_lock_entities;
+	if (vio6_lock(vio, funcs, 3, ents) < 0) {
+		debug_info("ERR: No entity available!");
+		return -1;
 	}
+	ent_src = ents[0];
+	ent_scale = ents[1];
+	ent_sink = ents[2];
 
 	vio->sink_entity = ent_sink;
 	vio6_reset(vio);
@@ -1118,10 +1157,7 @@ vio6_setup(
 
 	return 0;
 fail_link_entities:
-fail_lock_entities:
-	while (vio->locked_entities != NULL)
-		vio6_unlock(vio, vio->locked_entities);
-	vio->sink_entity = NULL;
+	vio6_unlock_all(vio);
 	return -1;
 }
 
@@ -1147,13 +1183,16 @@ static void
 vio6_start_bundle(SHVIO *vio, int bundle_lines)
 {
 	const struct ren_vid_surface *src = &vio->src_hw;
+	const struct ren_vid_surface *dst = &vio->dst_hw;
 	void *base_addr = vio->uio_mmio.iomem;
 	struct shvio_entity *entity = vio->sink_entity;
+	int ss = fmts[dst->format].c_ss_vert;
+	int y0, y1, c_lines;
 
 	if (entity == NULL)
 		return;
 
-	if (bundle_lines != vio->bundle_processing_lines) { 
+	if (bundle_lines != vio->bundle_processing_lines) {
 		struct shvio_entity *src_entity;
 
 		/* find a source entity from a linked entities chain */
@@ -1177,6 +1216,15 @@ vio6_start_bundle(SHVIO *vio, int bundle_lines)
 
 	/* start operation */
 	write_reg(base_addr, 1, CMD(entity->idx));
+
+	/* work out where the next stripe goes while this one runs, so that
+	   it can be armed as soon as the interrupt arrives */
+	y0 = dst_lines_for(vio, vio->src_lines_done);
+	y1 = dst_lines_for(vio, vio->src_lines_done + bundle_lines);
+	c_lines = y1 / ss - y0 / ss;
+	vio->next_dst_addr[0] = vio->dst_addr[0] + bpitch_y(dst) * (y1 - y0);
+	vio->next_dst_addr[1] = vio->dst_addr[1] + bpitch_c(dst) * c_lines;
+	vio->next_dst_addr[2] = vio->dst_addr[2] + bpitch_c(dst) * c_lines;
 }
 
 static int
@@ -1188,20 +1236,22 @@ vio6_wait(SHVIO *vio)
 	void *base_addr = vio->uio_mmio.iomem;
 	uint32_t vevtr;
 	uint32_t vstar;
-	int complete;
 	int filled_lines;
 
 	if (entity == NULL)
 		return -1;
 
-	do {
+	for (;;) {
 		/* wait for an interrupt */
-		uiomux_sleep(vio->uiomux, vio->uiores);
+		wait_irq(vio);
 
 		/* confirm the status */
 		vevtr = read_reg(base_addr, WPF_IRQ_STA(entity->idx));
-		complete = vevtr & 1;
-	} while (complete == 0);	/* End of VIO operation? */
+		PROBE3(wake, vio, vevtr);
+		if (vevtr & 1)		/* End of VIO operation? */
+			break;
+		vio->stats.spurious_wakeups++;
+	}
 
 	write_reg(base_addr, 0, WPF_IRQ_STA(entity->idx));   /* ack interrupts */
 
@@ -1210,37 +1260,27 @@ vio6_wait(SHVIO *vio)
 
 	if (vio->bundle_remaining_lines <= 0) {
 		/* unlock all entities */
-		while (vio->locked_entities != NULL)
-			vio6_unlock(vio, vio->locked_entities);
-		vio->sink_entity = NULL;
+		vio6_unlock_all(vio);
 		vio->bundle_remaining_lines = src->h;
 		vio->bundle_processing_lines = 0;
-	} else {
-		uint32_t val;
-
-		val = read_reg(base_addr, WPF_DSTM_ADDR_Y(entity->idx)) +
-			size_y(dst->format, dst->pitch,
-			       dst->bpitchy) * filled_lines;
-		write_reg(base_addr, val, WPF_DSTM_ADDR_Y(entity->idx));
-		if (is_ycbcr(dst->format)) {
-			val = read_reg(base_addr,
-				       WPF_DSTM_ADDR_C0(entity->idx)) +
-				size_c(dst->format, dst->pitch,
-				       dst->bpitchc) * filled_lines;
-			write_reg(base_addr, val,
-				  WPF_DSTM_ADDR_C0(entity->idx));
-		}
-		if (is_ycbcr_planar(dst->format)) {
-			val = read_reg(base_addr,
-				       WPF_DSTM_ADDR_C1(entity->idx)) +
-				size_c(dst->format, dst->pitch,
-				       dst->bpitchc) * filled_lines;
-			write_reg(base_addr, val,
-				  WPF_DSTM_ADDR_C1(entity->idx));
-		}
+		return 1;
 	}
 
-	return complete;
+	/* arm the next stripe with the addresses queued when it started */
+	vio6_wpf_set_addr(vio, entity, dst->format, vio->next_dst_addr);
+
+	/* more stripes to come */
+	return 0;
+}
+
+static int
+vio6_done_reg(SHVIO *vio, uint32_t *mask)
+{
+	if (vio->sink_entity == NULL)
+		return -1;
+
+	*mask = 1;
+	return WPF_IRQ_STA(vio->sink_entity->idx);
 }
 
 static int
@@ -1253,11 +1293,15 @@ vio6_setup_blend(
 {
 	uint32_t val;
 	void *base_addr;
-	struct shvio_entity *ent_src0, *ent_blend, *ent_sink;
+	struct ren_vid_surface srcs[N_BLEND_INPUTS];
+	int funcs[2 + 2 * N_BLEND_INPUTS];
+	struct shvio_entity *ents[2 + 2 * N_BLEND_INPUTS];
+	struct shvio_entity *ent_blend, *ent_sink;
 	int ret;
-	int i;
+	int i, n = 0;
 
-	if (src_count < 2 || src_count > N_BLEND_INPUTS) {
+	/* a single source is enough when blending onto the virtual input */
+	if (src_count < (virt ? 1 : 2) || src_count > N_BLEND_INPUTS) {
 		debug_info("ERR: Invalid number of blend input sources");
 		return -1;
 	}
@@ -1274,47 +1318,47 @@ vio6_setup_blend(
 		return -1;
 	}
 
-	/* unlock all entities once */
-	while (vio->locked_entities != NULL)
-		vio6_unlock(vio, vio->locked_entities);
-	vio->sink_entity = NULL;
-
-	ent_blend = vio6_lock(vio, SHVIO_FUNC_BLEND);
-	ent_sink = vio6_lock(vio, SHVIO_FUNC_SINK);
+	/* work out everything the job needs, then take it all at once */
+	funcs[n++] = SHVIO_FUNC_BLEND;
+	funcs[n++] = SHVIO_FUNC_SINK;
+	for (i = 0; i < src_count; i++) {
+		if (vio6_get_window(&srcs[i], src_list[i]) < 0)
+			return -1;
+		funcs[n++] = SHVIO_FUNC_SRC;
+		if (srcs[i].w != srcs[i].blend_out.w ||
+		    srcs[i].h != srcs[i].blend_out.h)
+			funcs[n++] = SHVIO_FUNC_SCALE;
+	}
 
-	if ((ent_sink == NULL) || (ent_blend == NULL)) {
-		debug_info("ERR: No entity unavailable!");
-		goto fail_lock_entities;
+	if (vio6_lock(vio, funcs, n, ents) < 0) {
+		debug_info("ERR: No entity available!");
+		return -1;
 	}
+	ent_blend = ents[0];
+	ent_sink = ents[1];
+	n = 2;
 
 	vio->sink_entity = ent_sink;
 	vio6_reset(vio);
 
 	for (i = 0; i < src_count; i++) {
 		struct shvio_entity *ent_src;
-		ent_src = vio6_lock(vio, SHVIO_FUNC_SRC);
-		if (ent_src == NULL) {
-			debug_info("ERR: No source entity unavailable!");
-			goto fail_lock_entities;
-		}
-		if (src_list[i]->w != src_list[i]->blend_out.w ||
-				src_list[i]->h != src_list[i]->blend_out.h) {
+		struct ren_vid_surface src = srcs[i];
+
+		ent_src = ents[n++];
+		if (src.w != src.blend_out.w || src.h != src.blend_out.h) {
 			struct shvio_entity *ent_scale;
 			struct ren_vid_surface scale_out;
-			scale_out = *(src_list[i]);
-			scale_out.w = src_list[i]->blend_out.w;
-			scale_out.h = src_list[i]->blend_out.h;
-			ent_scale = vio6_lock(vio, SHVIO_FUNC_SCALE);
-			if (ent_scale == NULL) {
-				debug_info("ERR: No scale entity unavailable!");
-				goto fail_lock_entities;
-			}
+			scale_out = src;
+			scale_out.w = src.blend_out.w;
+			scale_out.h = src.blend_out.h;
+			ent_scale = ents[n++];
 			ret = vio6_link(vio, ent_src, ent_scale, 0);	/* make a link from src to scale */
 			if (ret < 0) {
 				debug_info("ERR: cannot make a link from src to scale");
 				goto fail_link_entities;
 			}
-			vio6_uds_setup(vio, ent_scale, src_list[i], &scale_out);	/* color */
+			vio6_uds_setup(vio, ent_scale, &src, &scale_out);	/* color */
 			ret = vio6_link(vio, ent_scale, ent_blend, i);	/* make a link from scale to blend */
 			if (ret < 0) {
 				debug_info("ERR: cannot make a link from scale to blend");
@@ -1327,7 +1371,7 @@ vio6_setup_blend(
 				goto fail_link_entities;
 			}
 		}
-		vio6_rpf_setup(vio, ent_src, src_list[i], dst);	/* color */
+		vio6_rpf_setup(vio, ent_src, &src, dst);	/* color */
 	}
 
 	vio6_bru_setup(vio, ent_blend, virt, src_list, src_count, dst);	/* width, height */
@@ -1341,10 +1385,7 @@ vio6_setup_blend(
 
 	return 0;
 fail_link_entities:
-fail_lock_entities:
-	while (vio->locked_entities != NULL)
-		vio6_unlock(vio, vio->locked_entities);
-	vio->sink_entity = NULL;
+	vio6_unlock_all(vio);
 	return -1;
 }
 
@@ -1358,5 +1399,9 @@ const struct shvio_operations vio6_ops = {
 	.start = vio6_start,
 	.start_bundle = vio6_start_bundle,
 	.wait = vio6_wait,
+	.done_reg = vio6_done_reg,
 	.setup_blend = vio6_setup_blend,
+	.format_supported = format_supported,
+	.reg_name = vio6_reg_name,
+	.shares_hw = 1,
 };
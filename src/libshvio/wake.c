@@ -0,0 +1,246 @@
+/*
+ * libshvio: A library for controlling SH-Mobile VIO/VEU
+ * Copyright (C) 2009 Renesas Technology Corp.
+ * Copyright (C) 2010 Renesas Electronics Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Waiting for the hardware.
+ *
+ * Interrupts: every sleep is counted, and with SHVIO_TIMING_WAKE
+ * a thread polls the status register of the running job to tell when the
+ * hardware finished, so that the time the interrupt took to wake us can be
+ * measured. The hardware does not time stamp its completion, and spinning
+ * on a spare CPU is the only way to see it from user space.
+ *
+ * Polling: for states that raise no interrupt, such as the end of a reset,
+ * the register is read in a tight loop for a short while, then between
+ * yields of the CPU, then between sleeps that double up to a limit. A state
+ * that is not reached in time is an error, rather than a hang.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+#include <sched.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#define POLL_SPINS		100	/* reads before giving up the CPU */
+#define POLL_YIELD_US		50	/* time to yield before sleeping */
+#define POLL_MIN_SLEEP_NS	(10 * 1000)
+#define POLL_MAX_SLEEP_NS	(1000 * 1000)
+
+struct wake_probe {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	volatile int armed;
+	int quit;
+	int seen;			/* the hardware was seen to finish */
+	struct timespec done;		/* when */
+	volatile uint32_t *reg;		/* status register of the running job */
+	uint32_t mask;
+};
+
+static void *wake_poll(void *arg)
+{
+	struct wake_probe *w = arg;
+	struct timespec now;
+
+	pthread_mutex_lock(&w->lock);
+	while (!w->quit) {
+		if (!w->armed) {
+			pthread_cond_wait(&w->cond, &w->lock);
+			continue;
+		}
+		pthread_mutex_unlock(&w->lock);
+
+		while (w->armed && !(*w->reg & w->mask))
+			sched_yield();
+		clock_gettime(CLOCK_MONOTONIC, &now);
+
+		pthread_mutex_lock(&w->lock);
+		if (w->armed) {
+			w->done = now;
+			w->seen = 1;
+			w->armed = 0;
+		}
+	}
+	pthread_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+int wake_probe_start(SHVIO *vio)
+{
+	struct wake_probe *w;
+
+	if (vio->wake)
+		return 0;
+	if (!vio->ops.done_reg) {
+		debug_info("ERR: Wake-up timing unsupported by HW");
+		return -1;
+	}
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return -1;
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+	if (pthread_create(&w->thread, NULL, wake_poll, w) != 0) {
+		debug_info("ERR: Unable to start the wake-up timing thread");
+		pthread_cond_destroy(&w->cond);
+		pthread_mutex_destroy(&w->lock);
+		free(w);
+		return -1;
+	}
+
+	vio->wake = w;
+	return 0;
+}
+
+void wake_probe_stop(SHVIO *vio)
+{
+	struct wake_probe *w = vio->wake;
+
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->quit = 1;
+	w->armed = 0;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+	pthread_join(w->thread, NULL);
+
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->lock);
+	free(w);
+	vio->wake = NULL;
+}
+
+/* Watch for the end of the job that is about to start */
+void wake_arm(SHVIO *vio)
+{
+	struct wake_probe *w = vio->wake;
+	uint32_t mask;
+	int reg;
+
+	if (!w)
+		return;
+
+	reg = vio->ops.done_reg(vio, &mask);
+	if (reg < 0)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->reg = (volatile uint32_t *)((uint8_t *)vio->uio_mmio.iomem + reg);
+	w->mask = mask;
+	w->seen = 0;
+	w->armed = 1;
+	pthread_cond_signal(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* Stop watching, the job is over */
+void wake_disarm(SHVIO *vio)
+{
+	struct wake_probe *w = vio->wake;
+
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->armed = 0;
+	w->seen = 0;
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* Sleep until an interrupt */
+void wait_irq(SHVIO *vio)
+{
+	struct wake_probe *w = vio->wake;
+	struct timespec start;
+
+	stats_clock(vio, &start);
+	uiomux_sleep(vio->uiomux, vio->uiores);
+	stats_time(vio, SHVIO_PHASE_SLEEP, &start);
+
+	vio->stats.sleeps++;
+	vio->op_sleeps++;
+
+	/* Woken after the hardware was seen to finish? Otherwise the wake-up
+	   was early or spurious, or beat the polling thread, and says nothing */
+	if (w) {
+		pthread_mutex_lock(&w->lock);
+		if (w->seen) {
+			w->seen = 0;
+			stats_time(vio, SHVIO_PHASE_WAKE, &w->done);
+		}
+		pthread_mutex_unlock(&w->lock);
+	}
+}
+
+/* Poll until busy() returns 0, or for at most timeout_us */
+int poll_hw(SHVIO *vio, int (*busy)(SHVIO *vio), unsigned long timeout_us)
+{
+	struct timespec start, pause = { 0, POLL_MIN_SLEEP_NS };
+	unsigned long us;
+	int ret = 0;
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; busy(vio); i++) {
+		us = elapsed_us(&start);
+		if (us >= timeout_us) {
+			vio->stats.poll_timeouts++;
+			ret = -1;
+			break;
+		}
+
+		if (i < POLL_SPINS)
+			continue;
+		if (us < POLL_YIELD_US) {
+			sched_yield();
+		} else {
+			nanosleep(&pause, NULL);
+			pause.tv_nsec *= 2;
+			if (pause.tv_nsec > POLL_MAX_SLEEP_NS)
+				pause.tv_nsec = POLL_MAX_SLEEP_NS;
+		}
+	}
+
+	us = elapsed_us(&start);
+	vio->stats.polls++;
+	vio->stats.poll_us += us;
+	if (us > vio->stats.poll_max_us)
+		vio->stats.poll_max_us = us;
+
+	return ret;
+}
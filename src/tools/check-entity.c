@@ -0,0 +1,214 @@
+/*
+ * Test of the libshvio entity allocator.
+ *
+ * entity.c is linked in directly and run on a table shaped like the VIO6
+ * (four RPFs, two UDSs, a BRU and a WPF). A job that needs more entities
+ * than the table has must fail at once, even without a timeout, and must
+ * not hold up jobs that can run. Handles queueing for a whole device, as
+ * on the VEU, must get it in order of priority.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#define TIMEOUT_S	5	/* a wait this long is taken for a hang */
+#define SETTLE_US	(50 * 1000)	/* for a thread to start waiting */
+#define DEVICE_ADDR	0xfe920000	/* registers of the device */
+
+static struct shvio_entity ents[] = {
+	{ .idx = 0, .funcs = SHVIO_FUNC_SRC | SHVIO_FUNC_CSC },
+	{ .idx = 1, .funcs = SHVIO_FUNC_SRC | SHVIO_FUNC_CSC },
+	{ .idx = 2, .funcs = SHVIO_FUNC_SRC | SHVIO_FUNC_CSC },
+	{ .idx = 3, .funcs = SHVIO_FUNC_SRC | SHVIO_FUNC_CSC },
+	{ .idx = 0, .funcs = SHVIO_FUNC_SCALE | SHVIO_FUNC_CROP },
+	{ .idx = 1, .funcs = SHVIO_FUNC_SCALE | SHVIO_FUNC_CROP },
+	{ .idx = 0, .funcs = SHVIO_FUNC_BLEND },
+	{ .idx = 0, .funcs = SHVIO_FUNC_SINK },
+};
+
+#define NR_ENTS (int)(sizeof(ents) / sizeof(ents[0]))
+
+/* A blend of three scaled layers, with only two UDSs */
+static const int too_many[] = {
+	SHVIO_FUNC_BLEND, SHVIO_FUNC_SINK,
+	SHVIO_FUNC_SRC, SHVIO_FUNC_SCALE,
+	SHVIO_FUNC_SRC, SHVIO_FUNC_SCALE,
+	SHVIO_FUNC_SRC, SHVIO_FUNC_SCALE,
+};
+
+/* A scaled copy, which holds both UDSs when run twice */
+static const int scale[] = { SHVIO_FUNC_SRC, SHVIO_FUNC_SCALE };
+
+/* A plain copy */
+static const int copy[] = { SHVIO_FUNC_SRC, SHVIO_FUNC_SINK };
+
+#define N(funcs) (int)(sizeof(funcs) / sizeof(funcs[0]))
+
+static int failures;
+
+static void
+fail (const char * what)
+{
+	fprintf (stderr, "FAIL: %s\n", what);
+	failures++;
+}
+
+static void
+vio_init (SHVIO * vio, int timeout_ms)
+{
+	memset (vio, 0, sizeof(*vio));
+	vio->timeout_ms = timeout_ms;
+}
+
+static void
+free_all (struct shvio_entity ** out, int n)
+{
+	int i;
+
+	for (i=0; i<n; i++)
+		entity_free (ents, out[i]);
+}
+
+/* Ask for too many entities, with no timeout */
+static void *
+alloc_too_many (void * arg)
+{
+	struct shvio_entity *out[N(too_many)];
+	SHVIO vio;
+	int *ret = arg;
+
+	vio_init (&vio, -1);
+	*ret = entity_alloc (&vio, ents, NR_ENTS, too_many, N(too_many), out);
+	if (*ret == 0)
+		free_all (out, N(too_many));
+
+	return NULL;
+}
+
+static int order[2], nr_order;
+static pthread_mutex_t order_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct device_waiter {
+	SHVIO vio;
+	int id;
+};
+
+/* Wait for the whole device, and note when it was given */
+static void *
+lock_device (void * arg)
+{
+	struct device_waiter *w = arg;
+
+	if (device_lock (&w->vio) < 0)
+		return NULL;
+
+	pthread_mutex_lock (&order_lock);
+	order[nr_order++] = w->id;
+	pthread_mutex_unlock (&order_lock);
+
+	device_unlock (&w->vio);
+	return NULL;
+}
+
+/* While the device is held, a batch job then a display job wait for it.
+   The display job must get it first. */
+static void
+check_device_priority (void)
+{
+	struct device_waiter w[2];
+	pthread_t thread[2];
+	SHVIO holder, busy;
+	int i;
+
+	vio_init (&holder, -1);
+	holder.uio_mmio.address = DEVICE_ADDR;
+	if (device_lock (&holder) < 0) {
+		fail ("the free device was not given");
+		return;
+	}
+
+	for (i=0; i<2; i++) {
+		vio_init (&w[i].vio, -1);
+		w[i].vio.uio_mmio.address = DEVICE_ADDR;
+		w[i].vio.priority = i ? SHVIO_PRIO_DISPLAY : SHVIO_PRIO_BATCH;
+		w[i].id = i;
+		pthread_create (&thread[i], NULL, lock_device, &w[i]);
+		usleep (SETTLE_US);
+	}
+
+	/* with a timeout of 0, a busy device is not waited for */
+	vio_init (&busy, 0);
+	busy.uio_mmio.address = DEVICE_ADDR;
+	if (device_lock (&busy) == 0) {
+		fail ("a busy device was given without waiting");
+		device_unlock (&busy);
+	}
+
+	device_unlock (&holder);
+	for (i=0; i<2; i++)
+		pthread_join (thread[i], NULL);
+
+	if (nr_order != 2 || order[0] != 1)
+		fail ("the device was not given by priority");
+}
+
+int
+main (int argc, char *argv[])
+{
+	struct shvio_entity *held[2][N(scale)], *out[N(copy)];
+	pthread_t thread;
+	SHVIO vio;
+	int ret = 0;
+
+	/* a hang ends the test */
+	alarm (TIMEOUT_S);
+
+	/* an impossible job fails at once, even with nothing else running */
+	alloc_too_many (&ret);
+	if (ret == 0)
+		fail ("a job needing three UDSs was given them");
+
+	/* with the UDSs busy, an impossible job still fails at once, rather
+	   than wait for ever at the head of the queue */
+	vio_init (&vio, -1);
+	if (entity_alloc (&vio, ents, NR_ENTS, scale, N(scale), held[0]) < 0 ||
+	    entity_alloc (&vio, ents, NR_ENTS, scale, N(scale), held[1]) < 0) {
+		fprintf (stderr, "ERROR: Unable to take the UDSs\n");
+		return 1;
+	}
+
+	ret = 0;
+	if (pthread_create (&thread, NULL, alloc_too_many, &ret) != 0) {
+		fprintf (stderr, "ERROR: Unable to start a thread\n");
+		return 1;
+	}
+	pthread_join (thread, NULL);
+	if (ret == 0)
+		fail ("a job needing three UDSs was given them while two were busy");
+
+	/* and a job that can run is not held up behind it */
+	vio_init (&vio, 0);
+	if (entity_alloc (&vio, ents, NR_ENTS, copy, N(copy), out) < 0)
+		fail ("a job that can run was held up");
+	else
+		free_all (out, N(copy));
+
+	free_all (held[1], N(scale));
+	free_all (held[0], N(scale));
+
+	check_device_priority ();
+
+	if (failures)
+		fprintf (stderr, "%d failures\n", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,382 @@
+/*
+ * Test of the libshvio surface copies.
+ *
+ * copy_surface() and the bounce buffers of get_hw_surface() are linked in
+ * directly, with a stand-in for UIOMux, and their output is compared with a
+ * naive copy of each pixel. Every format is run with and without an alpha
+ * plane, between tight, padded and mismatched byte pitches on either side.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#define W	38
+#define H	10
+#define FILL	0x5a	/* bytes the copies must leave alone */
+
+struct layout {
+	const char *name;
+	int pitch;
+	int pad_y;		/* extra bytes of bpitchy, -1 for none */
+	int pad_c;		/* extra bytes of bpitchc, -1 for none */
+	int pad_a;		/* extra bytes of bpitcha, -1 for none */
+};
+
+/* Byte pitches derived from the pitch, or set on their own */
+static const struct layout layouts[] = {
+	{ "tight",	W,	-1, -1, -1 },
+	{ "padded",	W + 10,	-1, -1, -1 },
+	{ "bpitch",	W,	24, 8, 40 },
+	{ "mismatched",	W + 6,	40, -1, 3 },
+};
+
+#define NR_LAYOUTS (int)(sizeof(layouts) / sizeof(layouts[0]))
+
+static int failures;
+
+/* Bytes per line and lines of each plane of the active area */
+static size_t
+plane_len (const struct ren_vid_surface * s, int plane, int * lines)
+{
+	const struct format_info *fmt = &fmts[s->format];
+
+	switch (plane) {
+	case 0:
+		*lines = s->h;
+		return size_y (s->format, s->w, 0);
+	case 1:
+	case 2:
+		*lines = s->h / fmt->c_ss_vert;
+		return chroma_bpitch (s->format, s->w);
+	default:
+		*lines = s->h;
+		return s->w;
+	}
+}
+
+static uint8_t *
+plane_ptr (const struct ren_vid_surface * s, int plane)
+{
+	void *p[] = { s->py, s->pc, s->pc2, s->pa };
+	return p[plane];
+}
+
+static int
+plane_bpitch (const struct ren_vid_surface * s, int plane)
+{
+	switch (plane) {
+	case 0:
+		return bpitch_y (s);
+	case 1:
+	case 2:
+		return bpitch_c (s);
+	default:
+		return bpitch_a (s);
+	}
+}
+
+static size_t
+plane_size (const struct ren_vid_surface * s, int plane)
+{
+	int lines;
+
+	plane_len (s, plane, &lines);
+	return (size_t)plane_bpitch (s, plane) * lines;
+}
+
+static int
+has_plane (ren_vid_format_t format, int plane, int alpha)
+{
+	switch (plane) {
+	case 0:
+		return 1;
+	case 1:
+		return fmts[format].c_bpp != 0;
+	case 2:
+		return is_ycbcr_planar (format);
+	default:
+		return alpha;
+	}
+}
+
+/* Set up a surface with its planes in separate buffers */
+static int
+surface_init (struct ren_vid_surface * s, ren_vid_format_t format,
+	      const struct layout * l, int alpha)
+{
+	void **p[] = { &s->py, &s->pc, &s->pc2, &s->pa };
+	int plane;
+	size_t len;
+
+	memset (s, 0, sizeof(*s));
+	s->format = format;
+	s->w = W;
+	s->h = H;
+	s->pitch = l->pitch;
+	if (l->pad_y >= 0)
+		s->bpitchy = size_y (format, W, 0) + l->pad_y;
+	if (l->pad_c >= 0 && fmts[format].c_bpp)
+		s->bpitchc = chroma_bpitch (format, W) + l->pad_c;
+	if (l->pad_a >= 0)
+		s->bpitcha = W + l->pad_a;
+
+	for (plane=0; plane<4; plane++) {
+		if (!has_plane (format, plane, alpha))
+			continue;
+		len = plane_size (s, plane);
+		*p[plane] = malloc (len);
+		if (!*p[plane])
+			return -1;
+		memset (*p[plane], FILL, len);
+	}
+
+	return 0;
+}
+
+static void
+surface_fini (struct ren_vid_surface * s)
+{
+	free (s->py);
+	free (s->pc);
+	free (s->pc2);
+	free (s->pa);
+}
+
+/* Give every byte of the active area a value of its own */
+static void
+surface_pattern (struct ren_vid_surface * s)
+{
+	uint8_t *p;
+	size_t len, x;
+	int plane, lines, y;
+
+	for (plane=0; plane<4; plane++) {
+		if (!(p = plane_ptr (s, plane)))
+			continue;
+		len = plane_len (s, plane, &lines);
+		for (y=0; y<lines; y++)
+			for (x=0; x<len; x++)
+				p[y * plane_bpitch (s, plane) + x] = (plane << 6) ^ (y * 7) ^ x;
+	}
+}
+
+/* The reference: copy one pixel (or chroma sample) at a time */
+static void
+naive_copy (struct ren_vid_surface * out, const struct ren_vid_surface * in)
+{
+	const struct format_info *fmt = &fmts[in->format];
+	const uint8_t *src;
+	uint8_t *dst;
+	size_t len;
+	int plane, lines, bpp, x, y, b;
+
+	for (plane=0; plane<4; plane++) {
+		src = plane_ptr (in, plane);
+		dst = plane_ptr (out, plane);
+		if (!src || !dst)
+			continue;
+
+		len = plane_len (in, plane, &lines);
+		if (plane == 0)
+			bpp = fmt->y_bpp;
+		else if (plane == 3)
+			bpp = 1;
+		else
+			bpp = len / (in->w / fmt->c_ss_horz);
+
+		for (y=0; y<lines; y++)
+			for (x=0; x<(int)len / bpp; x++)
+				for (b=0; b<bpp; b++)
+					dst[y * plane_bpitch (out, plane) + x * bpp + b] =
+						src[y * plane_bpitch (in, plane) + x * bpp + b];
+	}
+}
+
+/* Compare two surfaces of the same layout, padding included */
+static int
+surface_cmp (const struct ren_vid_surface * a, const struct ren_vid_surface * b)
+{
+	int plane;
+
+	for (plane=0; plane<4; plane++) {
+		if (!plane_ptr (a, plane))
+			continue;
+		if (memcmp (plane_ptr (a, plane), plane_ptr (b, plane), plane_size (a, plane)))
+			return plane;
+	}
+
+	return -1;
+}
+
+/* Compare the active areas of two surfaces of any layout */
+static int
+active_cmp (const struct ren_vid_surface * a, const struct ren_vid_surface * b)
+{
+	size_t len;
+	int plane, lines, y;
+
+	for (plane=0; plane<4; plane++) {
+		if (!plane_ptr (a, plane))
+			continue;
+		len = plane_len (a, plane, &lines);
+		for (y=0; y<lines; y++) {
+			if (memcmp (plane_ptr (a, plane) + y * plane_bpitch (a, plane),
+				    plane_ptr (b, plane) + y * plane_bpitch (b, plane), len))
+				return plane;
+		}
+	}
+
+	return -1;
+}
+
+static void
+fail (const char * test, ren_vid_format_t format, int alpha,
+      const char * from, const char * to, int plane)
+{
+	static const char *planes[] = { "py", "pc", "pc2", "pa" };
+
+	fprintf (stderr, "FAIL: %s format %d%s %s -> %s: %s differs\n", test,
+		 format, alpha ? " with alpha" : "", from, to, planes[plane]);
+	failures++;
+}
+
+/* copy_surface() between every pair of layouts */
+static int
+check_copy_surface (ren_vid_format_t format, int alpha)
+{
+	struct ren_vid_surface in, out, ref;
+	int i, j, plane;
+
+	for (i=0; i<NR_LAYOUTS; i++) {
+		for (j=0; j<NR_LAYOUTS; j++) {
+			if (surface_init (&in, format, &layouts[i], alpha) < 0 ||
+			    surface_init (&out, format, &layouts[j], alpha) < 0 ||
+			    surface_init (&ref, format, &layouts[j], alpha) < 0) {
+				fprintf (stderr, "ERROR: Out of memory\n");
+				return -1;
+			}
+
+			surface_pattern (&in);
+			copy_surface (&out, &in);
+			naive_copy (&ref, &in);
+
+			if ((plane = surface_cmp (&ref, &out)) >= 0)
+				fail ("copy_surface", format, alpha,
+				      layouts[i].name, layouts[j].name, plane);
+
+			surface_fini (&ref);
+			surface_fini (&out);
+			surface_fini (&in);
+		}
+	}
+
+	return 0;
+}
+
+/* A bounce buffer from get_hw_surface() must hold every plane of a surface
+   the hardware cannot access, without overlap, and copy back unchanged */
+static int
+check_get_hw_surface (SHVIO * vio, ren_vid_format_t format, int alpha)
+{
+	struct ren_vid_surface in, hw, back;
+	int i, plane;
+
+	for (i=0; i<NR_LAYOUTS; i++) {
+		if (surface_init (&in, format, &layouts[i], alpha) < 0 ||
+		    surface_init (&back, format, &layouts[i], alpha) < 0) {
+			fprintf (stderr, "ERROR: Out of memory\n");
+			return -1;
+		}
+
+		surface_pattern (&in);
+		if (get_hw_surface (vio, BOUNCE_SRC, &hw, &in) < 0) {
+			fprintf (stderr, "ERROR: No bounce buffer\n");
+			return -1;
+		}
+		if (hw.py == in.py || !vio_virt_to_phys (vio, hw.py)) {
+			fprintf (stderr, "FAIL: get_hw_surface format %d %s: not bounced\n",
+				 format, layouts[i].name);
+			failures++;
+		}
+
+		copy_surface (&hw, &in);
+		if ((plane = active_cmp (&in, &hw)) >= 0)
+			fail ("get_hw_surface", format, alpha, layouts[i].name, "bounce", plane);
+
+		copy_surface (&back, &hw);
+		if ((plane = surface_cmp (&in, &back)) >= 0)
+			fail ("get_hw_surface", format, alpha, "bounce", layouts[i].name, plane);
+
+		surface_fini (&back);
+		surface_fini (&in);
+	}
+
+	return 0;
+}
+
+/* A surface the hardware can access is used as it is */
+static int
+check_get_hw_surface_direct (SHVIO * vio)
+{
+	struct ren_vid_surface in, hw;
+	size_t len = W * H * 2;
+
+	memset (&in, 0, sizeof(in));
+	in.format = REN_NV12;
+	in.w = W;
+	in.h = H;
+	in.pitch = W;
+	in.py = uiomux_malloc (NULL, 0, len, 32);
+	if (!in.py) {
+		fprintf (stderr, "ERROR: Out of memory\n");
+		return -1;
+	}
+	in.pc = (uint8_t *)in.py + W * H;
+
+	if (get_hw_surface (vio, BOUNCE_SRC, &hw, &in) < 0 ||
+	    memcmp (&hw, &in, sizeof(in))) {
+		fprintf (stderr, "FAIL: get_hw_surface bounced an accessible surface\n");
+		failures++;
+	}
+
+	uiomux_free (NULL, 0, in.py, len);
+	return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+	SHVIO vio;
+	int f, alpha;
+	int ret = 1;
+
+	memset (&vio, 0, sizeof(vio));
+
+	for (f=REN_NV12; f<=REN_VYUY; f++) {
+		for (alpha=0; alpha<=1; alpha++) {
+			if (check_copy_surface (f, alpha) < 0)
+				goto exit_release;
+			if (check_get_hw_surface (&vio, f, alpha) < 0)
+				goto exit_release;
+		}
+	}
+	if (check_get_hw_surface_direct (&vio) < 0)
+		goto exit_release;
+
+	if (failures)
+		fprintf (stderr, "%d failures\n", failures);
+	ret = failures ? 1 : 0;
+
+exit_release:
+	release_bounce (&vio);
+	return ret;
+}
@@ -0,0 +1,835 @@
+/*
+ * Benchmark of VIO/VEU operations.
+ *
+ * Each test case is run a number of times on buffers allocated for the
+ * hardware, and the throughput, latency percentiles and CPU time per
+ * operation are reported, as text or as JSON.
+ *
+ * Built with SHVIO_BENCH_SIM, as shvio-bench-sim, it runs on the simulated
+ * VEU of uiomux-sim.c and times the runs by its modelled clock.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+#include <math.h>
+
+#include "shvio/shvio.h"
+
+#define TEST_CONVERT	(1 << 0)
+#define TEST_SCALE	(1 << 1)
+#define TEST_ROTATE	(1 << 2)
+#define TEST_BLEND	(1 << 3)
+#define TEST_BUNDLE	(1 << 4)
+#define TEST_ALL	0x1f
+
+#define MAX_LAYERS	4
+
+#ifdef SHVIO_BENCH_SIM
+#define BACKEND		"sim"
+void sim_clock (struct timespec * ts);
+#else
+#define BACKEND		"hw"
+#endif
+
+static void
+usage (const char * progname)
+{
+	printf ("Usage: %s [options]\n", progname);
+	printf ("Benchmark the SH-Mobile VIO/VEU.\n");
+#ifdef SHVIO_BENCH_SIM
+	printf ("This build runs on a simulated VEU, timed by a modelled clock.\n");
+#endif
+	printf ("\nOptions\n");
+	printf ("  -t, --tests list       Comma separated tests to run (convert, scale, rotate,\n");
+	printf ("                         blend, bundle) [default: all]\n");
+	printf ("  -s, --size size        Set the source image size (qcif, cif, qvga, vga, d1, 720p)\n");
+	printf ("                         [default: vga]\n");
+	printf ("  -c, --input-colorspace Source colorspace for scale, rotate and bundle tests\n");
+	printf ("                         [default: NV12]\n");
+	printf ("  -C, --output-colorspace\n");
+	printf ("                         Output colorspace for scale, rotate and bundle tests\n");
+	printf ("                         [default: RGB565]\n");
+	printf ("  -n, --iterations n     Number of timed runs of each test [default: 20]\n");
+	printf ("  -r, --rounds n         Repeat the timed runs of each test n times, for the\n");
+	printf ("                         variation between rounds [default: 1]\n");
+	printf ("  -j, --json             Output the results as JSON\n");
+	printf ("  -b, --baseline file    Compare with the JSON results of a previous run and\n");
+	printf ("                         report regressions of throughput and p99 latency\n");
+	printf ("  -T, --tolerance pct    Ignore changes of less than pct percent [default: 5]\n");
+	printf ("\nMiscellaneous options\n");
+	printf ("  -u, --vio vio          Specify the name of VIO/VEU to use (default: any VEU)\n");
+	printf ("  -h, --help             Display this help and exit\n");
+	printf ("  -v, --version          Output version information and exit\n");
+	printf ("\n");
+	printf ("Please report bugs to <linux-sh@vger.kernel.org>\n");
+}
+
+struct sizes_t {
+	const char *name;
+	int w;
+	int h;
+};
+
+static const struct sizes_t sizes[] = {
+	{ "QCIF", 176,  144 },
+	{ "CIF",  352,  288 },
+	{ "QVGA", 320,  240 },
+	{ "VGA",  640,  480 },
+	{ "D1",   720,  480 },
+	{ "WVGA", 800, 450 },
+	{ "720p", 1280, 720 },
+};
+
+static int set_size (char * arg, int * w, int * h)
+{
+	int nr_sizes = sizeof(sizes) / sizeof(sizes[0]);
+	int i;
+
+	if (!arg)
+		return -1;
+
+	for (i=0; i<nr_sizes; i++) {
+		if (!strcasecmp (arg, sizes[i].name)) {
+			*w = sizes[i].w;
+			*h = sizes[i].h;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+struct colorspaces_t {
+	const char *name;
+	ren_vid_format_t fmt;
+};
+
+/* Every surface format, in the order of ren_vid_format_t */
+static const struct colorspaces_t colorspaces[] = {
+	{ "NV12",     REN_NV12 },
+	{ "NV16",     REN_NV16 },
+	{ "YV12",     REN_YV12 },
+	{ "YV16",     REN_YV16 },
+	{ "UYVY",     REN_UYVY },
+	{ "XRGB1555", REN_XRGB1555 },
+	{ "RGB565",   REN_RGB565 },
+	{ "RGB888",   REN_RGB24 },
+	{ "BGR888",   REN_BGR24 },
+	{ "RGBx888",  REN_RGB32 },
+	{ "xBGR888",  REN_BGR32 },
+	{ "xRGB888",  REN_XRGB32 },
+	{ "ABGR8888", REN_BGRA32 },
+	{ "ARGB8888", REN_ARGB32 },
+	{ "NV21",     REN_NV21 },
+	{ "YUYV",     REN_YUYV },
+	{ "YVYU",     REN_YVYU },
+	{ "VYUY",     REN_VYUY },
+};
+
+#define NR_COLORSPACES (int)(sizeof(colorspaces) / sizeof(colorspaces[0]))
+
+static int set_colorspace (char * arg, ren_vid_format_t * c)
+{
+	int i;
+
+	if (!arg)
+		return -1;
+
+	for (i=0; i<NR_COLORSPACES; i++) {
+		if (!strcasecmp (arg, colorspaces[i].name)) {
+			*c = colorspaces[i].fmt;
+			return 0;
+		}
+	}
+
+	return -1;
+}
+
+static const char * show_colorspace (ren_vid_format_t c)
+{
+	int i;
+
+	for (i=0; i<NR_COLORSPACES; i++) {
+		if (c == colorspaces[i].fmt)
+			return colorspaces[i].name;
+	}
+
+	return "none";
+}
+
+static int set_tests (char * arg)
+{
+	static const char *names[] = { "convert", "scale", "rotate", "blend", "bundle" };
+	char *tok, *save = NULL;
+	int tests = 0;
+	int i;
+
+	for (tok = strtok_r (arg, ",", &save); tok; tok = strtok_r (NULL, ",", &save)) {
+		for (i=0; i<5; i++) {
+			if (!strcasecmp (tok, names[i]))
+				break;
+		}
+		if (i == 5) {
+			fprintf (stderr, "ERROR: Unknown test %s\n", tok);
+			return -1;
+		}
+		tests |= 1 << i;
+	}
+
+	return tests;
+}
+
+/* A test case */
+struct bench_case {
+	const char *test;
+	ren_vid_format_t src_fmt;
+	ren_vid_format_t dst_fmt;
+	int src_w, src_h;
+	int dst_w, dst_h;
+	shvio_rotation_t rotate;
+	int layers;		/* blend sources, 0 if not a blend */
+	int bundle_lines;	/* 0 if not bundle mode */
+};
+
+static int iterations = 20;
+static int rounds = 1;
+static int json;
+static int nr_results;
+
+/* Results of a case, over all rounds */
+struct bench_stats {
+	double mpix, mpix_sd;	/* throughput per round, mean and deviation */
+	double p99, p99_sd;	/* p99 latency per round, mean and deviation */
+	int rounds;
+};
+
+/* A result of a previous run */
+struct baseline_result {
+	struct bench_case bc;
+	char src[16], dst[16], test[16];
+	int rotate;
+	struct bench_stats st;
+};
+
+static struct baseline_result *baseline;
+static int nr_baseline;
+static double tolerance = 5.0;	/* percent */
+static int nr_regressions;
+
+/* The time of a run, on the clock of the simulated device if there is one */
+static void
+bench_clock (struct timespec * ts)
+{
+#ifdef SHVIO_BENCH_SIM
+	sim_clock (ts);
+#else
+	clock_gettime (CLOCK_MONOTONIC, ts);
+#endif
+}
+
+static unsigned long
+elapsed_us (const struct timespec * start, const struct timespec * end)
+{
+	return (end->tv_sec - start->tv_sec) * 1000000 +
+		(end->tv_nsec - start->tv_nsec) / 1000;
+}
+
+static int cmp_ulong (const void * a, const void * b)
+{
+	unsigned long x = *(const unsigned long *)a;
+	unsigned long y = *(const unsigned long *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Run a case once */
+static int
+run_once (SHVIO * vio, const struct bench_case * bc,
+	  struct ren_vid_surface * src, struct ren_vid_surface * dst)
+{
+	const struct ren_vid_surface *layers[MAX_LAYERS];
+	struct ren_vid_surface s, d;
+	struct ren_vid_rect sel;
+	int y, complete;
+	int i;
+
+	if (bc->layers) {
+		for (i=0; i<bc->layers; i++)
+			layers[i] = &src[i];
+		if (shvio_setup_blend (vio, NULL, layers, bc->layers, dst) < 0)
+			return -1;
+		shvio_start (vio);
+		return (shvio_wait (vio) < 0) ? -1 : 0;
+	}
+
+	if (bc->bundle_lines) {
+		if (shvio_setup (vio, src, dst, SHVIO_NO_ROT) < 0)
+			return -1;
+
+		/* the source and destination are the same size */
+		sel.x = 0;
+		sel.w = src->w;
+		sel.h = bc->bundle_lines;
+		y = 0;
+		do {
+			sel.y = y;
+			get_sel_surface (&s, src, &sel);
+			get_sel_surface (&d, dst, &sel);
+			shvio_set_src (vio, s.py, s.pc);
+			shvio_set_dst (vio, d.py, d.pc);
+			shvio_start_bundle (vio, bc->bundle_lines);
+			complete = shvio_wait (vio);
+			y += bc->bundle_lines;
+		} while (complete == 0);
+
+		return (complete < 0) ? -1 : 0;
+	}
+
+	if (bc->rotate != SHVIO_NO_ROT)
+		return shvio_rotate (vio, src, dst, bc->rotate);
+
+	return shvio_resize (vio, src, dst);
+}
+
+static void
+mean_sd (const double * v, int n, double * mean, double * sd)
+{
+	double sum = 0, sq = 0;
+	int i;
+
+	for (i=0; i<n; i++)
+		sum += v[i];
+	*mean = sum / n;
+	for (i=0; i<n; i++)
+		sq += (v[i] - *mean) * (v[i] - *mean);
+	*sd = (n > 1) ? sqrt (sq / (n - 1)) : 0;
+}
+
+/* One-sided 95% critical value of Student's t, rounded towards safety */
+static double
+t_crit (double df)
+{
+	static const double t[] = {
+		6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860, 1.833, 1.812
+	};
+
+	if (df < 1)
+		return t[0];
+	if (df < 11)
+		return t[(int)df - 1];
+	if (df < 21)
+		return 1.796;
+	if (df < 31)
+		return 1.721;
+	return 1.697;
+}
+
+/* Whether a worse mean is a significant change: over the tolerance and,
+   when both sides have several rounds, by Welch's t-test */
+static int
+is_worse (double base, double base_sd, int base_n,
+	  double now, double now_sd, int now_n, int higher_is_worse)
+{
+	double diff = higher_is_worse ? now - base : base - now;
+	double vb, vn, se, df;
+
+	if (base <= 0 || diff * 100 / base <= tolerance)
+		return 0;
+	if (base_n < 2 || now_n < 2)
+		return 1;
+
+	vb = base_sd * base_sd / base_n;
+	vn = now_sd * now_sd / now_n;
+	se = sqrt (vb + vn);
+	if (se == 0)
+		return 1;
+	df = (vb + vn) * (vb + vn) /
+		(vb * vb / (base_n - 1) + vn * vn / (now_n - 1));
+
+	return diff / se > t_crit (df);
+}
+
+static const struct baseline_result *
+find_baseline (const struct bench_case * bc)
+{
+	const struct baseline_result *b;
+	int rotate = (bc->rotate == SHVIO_ROT_90) ? 90 : 0;
+	int i;
+
+	for (i=0; i<nr_baseline; i++) {
+		b = &baseline[i];
+		if (!strcmp (b->test, bc->test) &&
+		    !strcmp (b->src, show_colorspace (bc->src_fmt)) &&
+		    !strcmp (b->dst, show_colorspace (bc->dst_fmt)) &&
+		    b->bc.src_w == bc->src_w && b->bc.src_h == bc->src_h &&
+		    b->bc.dst_w == bc->dst_w && b->bc.dst_h == bc->dst_h &&
+		    b->rotate == rotate && b->bc.layers == bc->layers &&
+		    b->bc.bundle_lines == bc->bundle_lines)
+			return b;
+	}
+
+	return NULL;
+}
+
+/* Read the results of a previous JSON run */
+static int
+load_baseline (const char * path, const char * device)
+{
+	struct baseline_result *b;
+	char line[1024], dev[64], backend[16];
+	FILE *fp = fopen (path, "r");
+	int max = 0;
+
+	if (!fp) {
+		fprintf (stderr, "ERROR: Unable to open %s\n", path);
+		return -1;
+	}
+
+	while (fgets (line, sizeof(line), fp)) {
+		if (sscanf (line, " \"device\": \"%63[^\"]\"", dev) == 1) {
+			if (strcmp (dev, device))
+				fprintf (stderr, "Warning: baseline is of %s, not %s\n", dev, device);
+			continue;
+		}
+		if (sscanf (line, " \"backend\": \"%15[^\"]\"", backend) == 1) {
+			if (strcmp (backend, BACKEND)) {
+				fprintf (stderr, "ERROR: baseline is of the %s backend, not %s\n",
+					 backend, BACKEND);
+				fclose (fp);
+				return -1;
+			}
+			continue;
+		}
+
+		if (nr_baseline == max) {
+			max = max ? max * 2 : 64;
+			b = realloc (baseline, max * sizeof(*b));
+			if (!b) {
+				fclose (fp);
+				return -1;
+			}
+			baseline = b;
+		}
+		b = &baseline[nr_baseline];
+		memset (b, 0, sizeof(*b));
+		if (sscanf (line, " {\"test\": \"%15[^\"]\", \"src\": \"%15[^\"]\", "
+			    "\"dst\": \"%15[^\"]\", \"src_w\": %d, \"src_h\": %d, "
+			    "\"dst_w\": %d, \"dst_h\": %d, \"rotate\": %d, \"layers\": %d, "
+			    "\"bundle_lines\": %d, \"iterations\": %*d, \"rounds\": %d, "
+			    "\"mpix_per_s\": %lf, \"mpix_per_s_sd\": %lf, "
+			    "\"latency_us\": {\"p50\": %*u, \"p90\": %*u, \"p99\": %*u, \"max\": %*u}, "
+			    "\"p99_us_mean\": %lf, \"p99_us_sd\": %lf",
+			    b->test, b->src, b->dst,
+			    &b->bc.src_w, &b->bc.src_h, &b->bc.dst_w, &b->bc.dst_h,
+			    &b->rotate, &b->bc.layers, &b->bc.bundle_lines, &b->st.rounds,
+			    &b->st.mpix, &b->st.mpix_sd, &b->st.p99, &b->st.p99_sd) == 15)
+			nr_baseline++;
+	}
+
+	fclose (fp);
+
+	if (nr_baseline == 0) {
+		fprintf (stderr, "ERROR: No results in %s\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Flag significant drops of throughput and rises of p99 latency */
+static void
+compare_result (const struct bench_case * bc, const struct bench_stats * st)
+{
+	const struct baseline_result *b = find_baseline (bc);
+	const struct bench_stats *bs;
+
+	if (!b)
+		return;
+	bs = &b->st;
+
+	if (is_worse (bs->mpix, bs->mpix_sd, bs->rounds,
+		      st->mpix, st->mpix_sd, st->rounds, 0)) {
+		fprintf (stderr, "REGRESSION %s %s -> %s %dx%d -> %dx%d: %.2f -> %.2f Mpix/s (%+.1f%%)\n",
+			 bc->test, show_colorspace (bc->src_fmt), show_colorspace (bc->dst_fmt),
+			 bc->src_w, bc->src_h, bc->dst_w, bc->dst_h,
+			 bs->mpix, st->mpix, (st->mpix - bs->mpix) * 100 / bs->mpix);
+		nr_regressions++;
+	}
+
+	if (is_worse (bs->p99, bs->p99_sd, bs->rounds,
+		      st->p99, st->p99_sd, st->rounds, 1)) {
+		fprintf (stderr, "REGRESSION %s %s -> %s %dx%d -> %dx%d: p99 %.0f -> %.0f us (%+.1f%%)\n",
+			 bc->test, show_colorspace (bc->src_fmt), show_colorspace (bc->dst_fmt),
+			 bc->src_w, bc->src_h, bc->dst_w, bc->dst_h,
+			 bs->p99, st->p99, (st->p99 - bs->p99) * 100 / bs->p99);
+		nr_regressions++;
+	}
+}
+
+static void
+print_result (const struct bench_case * bc, const struct bench_stats * st,
+	      unsigned long * lat, unsigned long cpu_us)
+{
+	int n = iterations * rounds;
+
+	qsort (lat, n, sizeof(lat[0]), cmp_ulong);
+
+	if (json) {
+		printf ("%s\n    {\"test\": \"%s\", \"src\": \"%s\", \"dst\": \"%s\", "
+			"\"src_w\": %d, \"src_h\": %d, \"dst_w\": %d, \"dst_h\": %d, "
+			"\"rotate\": %d, \"layers\": %d, \"bundle_lines\": %d, "
+			"\"iterations\": %d, \"rounds\": %d, "
+			"\"mpix_per_s\": %.3f, \"mpix_per_s_sd\": %.3f, "
+			"\"latency_us\": {\"p50\": %lu, \"p90\": %lu, \"p99\": %lu, \"max\": %lu}, "
+			"\"p99_us_mean\": %.1f, \"p99_us_sd\": %.1f, "
+			"\"cpu_us\": %lu}",
+			nr_results ? "," : "",
+			bc->test, show_colorspace (bc->src_fmt), show_colorspace (bc->dst_fmt),
+			bc->src_w, bc->src_h, bc->dst_w, bc->dst_h,
+			(bc->rotate == SHVIO_ROT_90) ? 90 : 0, bc->layers, bc->bundle_lines,
+			iterations, rounds, st->mpix, st->mpix_sd,
+			lat[(n-1) * 50 / 100], lat[(n-1) * 90 / 100], lat[(n-1) * 99 / 100],
+			lat[n-1], st->p99, st->p99_sd, cpu_us / n);
+	} else {
+		printf ("%-8s %-8s -> %-8s %4dx%-4d -> %4dx%-4d rot %2d layers %d bundle %3d: "
+			"%8.2f Mpix/s, p50 %6lu p90 %6lu p99 %6lu max %6lu us, cpu %6lu us\n",
+			bc->test, show_colorspace (bc->src_fmt), show_colorspace (bc->dst_fmt),
+			bc->src_w, bc->src_h, bc->dst_w, bc->dst_h,
+			(bc->rotate == SHVIO_ROT_90) ? 90 : 0, bc->layers, bc->bundle_lines,
+			st->mpix,
+			lat[(n-1) * 50 / 100], lat[(n-1) * 90 / 100], lat[(n-1) * 99 / 100],
+			lat[n-1], cpu_us / n);
+	}
+
+	nr_results++;
+}
+
+/* Allocate the buffers of a case, run it and report the results */
+static int
+run_case (SHVIO * vio, const struct bench_case * bc)
+{
+	struct ren_vid_surface src[MAX_LAYERS], dst;
+	struct timespec start, end, cpu_start, cpu_end;
+	struct bench_stats st;
+	unsigned long *lat, *round_lat;
+	unsigned long total_us;
+	double *mpix, *p99;
+	int nr_src = bc->layers ? bc->layers : 1;
+	int ret = -1;
+	int i, r, n = 0;
+
+	if (!shvio_format_supported (vio, bc->src_fmt) ||
+	    !shvio_format_supported (vio, bc->dst_fmt))
+		return 0;
+
+	lat = calloc (iterations * rounds, sizeof(lat[0]));
+	round_lat = calloc (iterations, sizeof(round_lat[0]));
+	mpix = calloc (rounds, sizeof(mpix[0]));
+	p99 = calloc (rounds, sizeof(p99[0]));
+	if (!lat || !round_lat || !mpix || !p99)
+		goto done;
+
+	for (n=0; n<nr_src; n++) {
+		if (shvio_surface_alloc (vio, &src[n], bc->src_fmt, bc->src_w, bc->src_h, 0) < 0) {
+			fprintf (stderr, "Error allocating input buffer\n");
+			goto done;
+		}
+		memset (src[n].py, 0x80, src[n].bpitchy * src[n].h);
+		src[n].blend_out.x = src[n].blend_out.y = 0;
+		src[n].blend_out.w = src[n].w;
+		src[n].blend_out.h = src[n].h;
+	}
+	if (shvio_surface_alloc (vio, &dst, bc->dst_fmt, bc->dst_w, bc->dst_h, 0) < 0) {
+		fprintf (stderr, "Error allocating output buffer\n");
+		goto done;
+	}
+
+	/* the first run is not timed, and finds out if the case is supported */
+	if (run_once (vio, bc, src, &dst) < 0) {
+		fprintf (stderr, "Skipped %s %s -> %s: not supported\n",
+			 bc->test, show_colorspace (bc->src_fmt), show_colorspace (bc->dst_fmt));
+		ret = 0;
+		goto free_dst;
+	}
+
+	clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &cpu_start);
+	for (r=0; r<rounds; r++) {
+		total_us = 0;
+		for (i=0; i<iterations; i++) {
+			bench_clock (&start);
+			if (run_once (vio, bc, src, &dst) < 0) {
+				fprintf (stderr, "Error running %s\n", bc->test);
+				goto free_dst;
+			}
+			bench_clock (&end);
+			round_lat[i] = elapsed_us (&start, &end);
+			total_us += round_lat[i];
+		}
+		memcpy (&lat[r * iterations], round_lat, iterations * sizeof(lat[0]));
+
+		qsort (round_lat, iterations, sizeof(round_lat[0]), cmp_ulong);
+		mpix[r] = total_us ? (double)bc->dst_w * bc->dst_h * iterations / total_us : 0;
+		p99[r] = round_lat[(iterations-1) * 99 / 100];
+	}
+	clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &cpu_end);
+
+	st.rounds = rounds;
+	mean_sd (mpix, rounds, &st.mpix, &st.mpix_sd);
+	mean_sd (p99, rounds, &st.p99, &st.p99_sd);
+
+	print_result (bc, &st, lat, elapsed_us (&cpu_start, &cpu_end));
+	if (nr_baseline)
+		compare_result (bc, &st);
+	ret = 0;
+
+free_dst:
+	shvio_surface_free (vio, &dst);
+done:
+	while (n-- > 0)
+		shvio_surface_free (vio, &src[n]);
+	free (lat);
+	free (round_lat);
+	free (mpix);
+	free (p99);
+	return ret;
+}
+
+int main (int argc, char * argv[])
+{
+	/* scale ratios, in quarters */
+	static const int ratios[] = { 1, 2, 3, 6, 8 };
+	static const int bundles[] = { 16, 32, 64, 128 };
+	int nr_ratios = sizeof(ratios) / sizeof(ratios[0]);
+	int nr_bundles = sizeof(bundles) / sizeof(bundles[0]);
+	SHVIO *vio;
+	struct bench_case bc;
+	ren_vid_format_t src_fmt = REN_NV12, dst_fmt = REN_RGB565;
+	int w = 640, h = 480;
+	int tests = TEST_ALL;
+	int i, j;
+
+	int show_version = 0;
+	int show_help = 0;
+	char * progname;
+	char * viodev = NULL;
+	char * baseline_path = NULL;
+
+	int c;
+	char * optstring = "hvt:s:c:C:n:r:jb:T:u:";
+
+#ifdef HAVE_GETOPT_LONG
+	static struct option long_options[] = {
+		{"help", no_argument, 0, 'h'},
+		{"version", no_argument, 0, 'v'},
+		{"tests", required_argument, 0, 't'},
+		{"size", required_argument, 0, 's'},
+		{"input-colorspace", required_argument, 0, 'c'},
+		{"output-colorspace", required_argument, 0, 'C'},
+		{"iterations", required_argument, 0, 'n'},
+		{"rounds", required_argument, 0, 'r'},
+		{"json", no_argument, 0, 'j'},
+		{"baseline", required_argument, 0, 'b'},
+		{"tolerance", required_argument, 0, 'T'},
+		{"vio", required_argument, 0, 'u'},
+		{NULL,0,0,0}
+	};
+#endif
+
+	progname = argv[0];
+
+	while (1) {
+#ifdef HAVE_GETOPT_LONG
+		c = getopt_long (argc, argv, optstring, long_options, NULL);
+#else
+		c = getopt (argc, argv, optstring);
+#endif
+		if (c == -1) break;
+		if (c == ':') {
+			usage (progname);
+			goto exit_err;
+		}
+
+		switch (c) {
+		case 'h': /* help */
+			show_help = 1;
+			break;
+		case 'v': /* version */
+			show_version = 1;
+			break;
+		case 't': /* tests */
+			if ((tests = set_tests (optarg)) < 0)
+				goto exit_err;
+			break;
+		case 's': /* size */
+			if (set_size (optarg, &w, &h) < 0) {
+				fprintf (stderr, "ERROR: Unknown size %s\n", optarg);
+				goto exit_err;
+			}
+			break;
+		case 'c': /* input colorspace */
+			if (set_colorspace (optarg, &src_fmt) < 0) {
+				fprintf (stderr, "ERROR: Unknown colorspace %s\n", optarg);
+				goto exit_err;
+			}
+			break;
+		case 'C': /* output colorspace */
+			if (set_colorspace (optarg, &dst_fmt) < 0) {
+				fprintf (stderr, "ERROR: Unknown colorspace %s\n", optarg);
+				goto exit_err;
+			}
+			break;
+		case 'n': /* iterations */
+			iterations = atoi (optarg);
+			if (iterations < 1) {
+				fprintf (stderr, "ERROR: Invalid number of iterations\n");
+				goto exit_err;
+			}
+			break;
+		case 'r': /* rounds */
+			rounds = atoi (optarg);
+			if (rounds < 1) {
+				fprintf (stderr, "ERROR: Invalid number of rounds\n");
+				goto exit_err;
+			}
+			break;
+		case 'j': /* json */
+			json = 1;
+			break;
+		case 'b': /* baseline */
+			baseline_path = optarg;
+			break;
+		case 'T': /* tolerance */
+			tolerance = atof (optarg);
+			if (tolerance < 0) {
+				fprintf (stderr, "ERROR: Invalid tolerance\n");
+				goto exit_err;
+			}
+			break;
+		case 'u':
+			viodev = optarg;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (show_version) {
+		printf ("%s version " VERSION "\n", progname);
+	}
+
+	if (show_help) {
+		usage (progname);
+	}
+
+	if (show_version || show_help) {
+		goto exit_ok;
+	}
+
+	if (baseline_path && load_baseline (baseline_path, viodev ? viodev : "VEU") < 0)
+		goto exit_err;
+
+	if (!viodev)
+		vio = shvio_open();
+	else
+		vio = shvio_open_named(viodev);
+
+	if (vio == 0) {
+		fprintf (stderr, "Error opening VIO\n");
+		goto exit_err;
+	}
+
+	if (json)
+		printf ("{\n  \"device\": \"%s\",\n  \"backend\": \"%s\",\n  \"results\": [",
+			viodev ? viodev : "VEU", BACKEND);
+
+	memset (&bc, 0, sizeof(bc));
+	bc.src_w = bc.dst_w = w;
+	bc.src_h = bc.dst_h = h;
+
+	/* every pair of formats, without scaling */
+	if (tests & TEST_CONVERT) {
+		bc.test = "convert";
+		for (i=0; i<NR_COLORSPACES; i++) {
+			for (j=0; j<NR_COLORSPACES; j++) {
+				bc.src_fmt = colorspaces[i].fmt;
+				bc.dst_fmt = colorspaces[j].fmt;
+				if (run_case (vio, &bc) < 0)
+					goto exit_close;
+			}
+		}
+	}
+
+	bc.src_fmt = src_fmt;
+	bc.dst_fmt = dst_fmt;
+
+	if (tests & TEST_SCALE) {
+		bc.test = "scale";
+		for (i=0; i<nr_ratios; i++) {
+			bc.dst_w = (w * ratios[i] / 4) & ~15;
+			bc.dst_h = (h * ratios[i] / 4) & ~1;
+			if (run_case (vio, &bc) < 0)
+				goto exit_close;
+		}
+		bc.dst_w = w;
+		bc.dst_h = h;
+	}
+
+	if (tests & TEST_ROTATE) {
+		bc.test = "rotate";
+		bc.rotate = SHVIO_ROT_90;
+		bc.dst_w = h;
+		bc.dst_h = w;
+		if (run_case (vio, &bc) < 0)
+			goto exit_close;
+		bc.rotate = SHVIO_NO_ROT;
+		bc.dst_w = w;
+		bc.dst_h = h;
+	}
+
+	if ((tests & TEST_BUNDLE) && shvio_has_bundle (vio)) {
+		bc.test = "bundle";
+		for (i=0; i<nr_bundles; i++) {
+			bc.bundle_lines = bundles[i];
+			if (run_case (vio, &bc) < 0)
+				goto exit_close;
+		}
+		bc.bundle_lines = 0;
+	}
+
+	/* blend layers of the output format; a single layer needs a virtual
+	   background, which the benchmark does not pass, so start at two */
+	if (tests & TEST_BLEND) {
+		bc.test = "blend";
+		bc.src_fmt = dst_fmt;
+		for (i=2; i<=MAX_LAYERS; i++) {
+			bc.layers = i;
+			if (run_case (vio, &bc) < 0)
+				goto exit_close;
+		}
+	}
+
+	if (json)
+		printf ("\n  ]\n}\n");
+
+	shvio_close (vio);
+
+	if (nr_regressions) {
+		fprintf (stderr, "%d regressions against %s\n", nr_regressions, baseline_path);
+		exit (2);
+	}
+
+exit_ok:
+	exit (0);
+
+exit_close:
+	shvio_close (vio);
+exit_err:
+	exit (1);
+}
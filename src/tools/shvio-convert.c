@@ -39,13 +39,13 @@ usage (const char * progname)
 	printf ("If no input filename is specified, data is read from stdin.\n");
 	printf ("Specify '-' to force input to be read from stdin.\n");
 	printf ("\nInput options\n");
-	printf ("  -c, --input-colorspace (RGB565, RGB888, BGR888, RGBx888, NV12, YV12, NV16, YV16, UYVY)\n");
+	printf ("  -c, --input-colorspace (RGB565, RGB888, BGR888, RGBx888, NV12, NV21, YV12, NV16, YV16, UYVY, YUYV, YVYU, VYUY)\n");
 	printf ("                         Specify input colorspace\n");
 	printf ("  -s, --input-size       Set the input image size (qcif, cif, qvga, vga, d1, 720p)\n");
 	printf ("\nOutput options\n");
 	printf ("  -o filename, --output filename\n");
 	printf ("                         Specify output filename (default: stdout)\n");
-	printf ("  -C, --output-colorspace (RGB565, RGB888, BGR888, RGBx888, NV12, YV12, NV16, YV16, UYVY)\n");
+	printf ("  -C, --output-colorspace (RGB565, RGB888, BGR888, RGBx888, NV12, NV21, YV12, NV16, YV16, UYVY, YUYV, YVYU, VYUY)\n");
 	printf ("                         Specify output colorspace\n");
 	printf ("  -O filename, --overlay filename\n");
 	printf ("                         Specify overlayed filename (default: none)\n");
@@ -135,6 +135,11 @@ static const struct extensions_t exts[] = {
 	{ "YV16",     REN_YV16 },
 	{ "NV16",     REN_NV16 },
 	{ "UYVY",     REN_UYVY },
+	{ "NV21",     REN_NV21 },
+	{ "YUYV",     REN_YUYV },
+	{ "YUY2",     REN_YUYV },
+	{ "YVYU",     REN_YVYU },
+	{ "VYUY",     REN_VYUY },
 };
 
 static int set_colorspace (char * arg, ren_vid_format_t * c)
@@ -200,6 +205,37 @@ static off_t imgsize (ren_vid_format_t colorspace, int w, int h)
 	return (off_t)(size_y(colorspace, w*h, 0) + size_c(colorspace, w*h, 0));
 }
 
+/* Read or write the lines of a plane */
+static size_t plane_io (FILE * f, void * p, int bpitch, size_t len, int lines, int write)
+{
+	size_t n = 0;
+	int y;
+
+	for (y = 0; y < lines; y++, p += bpitch)
+		n += write ? fwrite (p, 1, len, f) : fread (p, 1, len, f);
+
+	return n;
+}
+
+/* Read or write a surface as an image with no padding between lines */
+static size_t surface_io (FILE * f, const struct ren_vid_surface * s, int write)
+{
+	const struct format_info *fmt = &fmts[s->format];
+	int c_lines = s->h / fmt->c_ss_vert;
+	size_t c_len = s->w / fmt->c_ss_horz * fmt->c_bpp;
+	size_t n;
+
+	n = plane_io (f, s->py, s->bpitchy, size_y(s->format, s->w, 0), s->h, write);
+	if (is_ycbcr_planar(s->format)) {
+		c_len /= 2;
+		n += plane_io (f, s->pc2, s->bpitchc, c_len, c_lines, write);	/* Cr(V) */
+	}
+	if (s->pc)
+		n += plane_io (f, s->pc, s->bpitchc, c_len, c_lines, write);	/* CbCr(UV) or Cb(U) */
+
+	return n;
+}
+
 static int guess_colorspace (char * filename, ren_vid_format_t * c)
 {
 	char * ext;
@@ -245,9 +281,6 @@ static int guess_size (char * filename, ren_vid_format_t colorspace, int * w, in
 
 int main (int argc, char * argv[])
 {
-	UIOMux * uiomux;
-	uiomux_resource_t uiores;
-
 	char * infilename[2] = {NULL, NULL}, * outfilename = NULL;
 	FILE * infile[2], * outfile = NULL;
 	size_t nread;
@@ -258,7 +291,7 @@ int main (int argc, char * argv[])
 		&src[0], &src[1]
 	};
 	struct ren_vid_surface dst;
-	void *inbuf[2], *outbuf;
+	struct ren_vid_surface inbuf[2], outbuf;
 	int ret;
 	int frameno=0;
 
@@ -307,6 +340,8 @@ int main (int argc, char * argv[])
 	ICB *icbr, *icbw;
 #endif /* defined(USE_MERAM_RA) || defined(USE_MERAM_WB) */
 
+	memset(&src[0], 0, sizeof(src[0]));
+	memset(&dst, 0, sizeof(dst));
 	src[0].w = -1;
 	src[0].h = -1;
 	dst.w = -1;
@@ -485,56 +520,36 @@ int main (int argc, char * argv[])
 		input_size[1] = imgsize (src[1].format, src[1].w, src[1].h);
 	output_size = imgsize (dst.format, dst.w, dst.h);
 
-	if (viodev) {
-		const char *blocks[2] = { viodev, NULL };
-		uiomux = uiomux_open_named(blocks);
-		uiores = 1 << 0;
-	} else {
-		uiomux = uiomux_open ();
-		uiores = UIOMUX_SH_VEU;
+	if (!viodev)
+		vio = shvio_open();
+	else
+		vio = shvio_open_named(viodev);
+
+	if (vio == 0) {
+		fprintf (stderr, "Error opening VIO\n");
+		goto exit_err;
 	}
 
 	/* Set up memory buffers */
-	src[0].py = inbuf[0] = uiomux_malloc (uiomux, uiores, input_size[0], 32);
-	if (src[0].format == REN_RGB565) {
-		src[0].pc = 0;
-	} else if (src[0].format == REN_YV12) {
-		src[0].pc2 = src[0].py + (src[0].w * src[0].h);	/* Cr(V) */
-		src[0].pc = src[0].pc2 + (src[0].w * src[0].h) / 4;	/* Cb(U) */
-	} else if (src[0].format == REN_YV16) {
-		src[0].pc2 = src[0].py + (src[0].w * src[0].h);	/* Cr(V) */
-		src[0].pc = src[0].pc2 + (src[0].w * src[0].h) / 2;	/* Cb(U) */
-	} else {
-		src[0].pc = src[0].py + (src[0].w * src[0].h);	/* CbCr(UV) */
+	if (shvio_surface_alloc (vio, &src[0], src[0].format, src[0].w, src[0].h, 0) < 0) {
+		fprintf (stderr, "Error allocating input buffer\n");
+		goto exit_err;
 	}
+	inbuf[0] = src[0];
 
 	if (infilename[1] != NULL) {
-		src[1].py = inbuf[1] = uiomux_malloc (uiomux, uiores, input_size[1], 32);
-		if (src[1].format == REN_RGB565) {
-			src[1].pc = 0;
-		} else if (src[1].format == REN_YV12) {
-			src[1].pc2 = src[1].py + (src[1].w * src[1].h);	/* Cr(V) */
-			src[1].pc = src[1].pc2 + (src[1].w * src[1].h) / 4;	/* Cb(U) */
-		} else if (src[1].format == REN_YV16) {
-			src[1].pc2 = src[1].py + (src[1].w * src[1].h);	/* Cr(V) */
-			src[1].pc = src[1].pc2 + (src[1].w * src[1].h) / 2;	/* Cb(U) */
-		} else {
-			src[1].pc = src[1].py + (src[1].w * src[1].h);	/* CbCr(UV) */
+		if (shvio_surface_alloc (vio, &src[1], src[1].format, src[1].w, src[1].h, 0) < 0) {
+			fprintf (stderr, "Error allocating overlay buffer\n");
+			goto exit_err;
 		}
+		inbuf[1] = src[1];
 	}
 
-	dst.py = outbuf = uiomux_malloc (uiomux, uiores, output_size, 32);
-	if (dst.format == REN_RGB565) {
-		dst.pc = 0;
-	} else if (dst.format == REN_YV12) {
-		dst.pc2 = dst.py + (dst.w * dst.h);	/* Cr(V) */
-		dst.pc = dst.pc2 + (dst.w * dst.h) / 4;	/* Cb(U) */
-	} else if (dst.format == REN_YV16) {
-		dst.pc2 = dst.py + (dst.w * dst.h);	/* Cr(V) */
-		dst.pc = dst.pc2 + (dst.w * dst.h) / 2;	/* Cb(U) */
-	} else {
-		dst.pc = dst.py + (dst.w * dst.h);	/* CbCr(UV) */
+	if (shvio_surface_alloc (vio, &dst, dst.format, dst.w, dst.h, 0) < 0) {
+		fprintf (stderr, "Error allocating output buffer\n");
+		goto exit_err;
 	}
+	outbuf = dst;
 
 #if defined(USE_MERAM_RA) || defined(USE_MERAM_WB)
 	meram_read_reg(meram, regs, MEVCR1, &val);
@@ -553,7 +568,7 @@ int main (int argc, char * argv[])
 		((16 - 1) << 16);	/* BNM: 16 = KRBNM * 2 lines */
 	ADJUST_PITCH(sz, src[0].bpitchy);
 	sz *= 16;			/* 16 lines */
-	if (src[0].format == REN_NV12) {
+	if (src[0].format == REN_NV12 || src[0].format == REN_NV21) {
 		val |= 2 << 12;	/* CPL: YCbCr420 */
 		sz = sz * 3 / 2;
 	} else if (src[0].format == REN_NV16) {
@@ -607,7 +622,7 @@ int main (int argc, char * argv[])
 		((16 - 1) << 16);	/* BNM: 16 = KWBNM * 2 lines */
 	ADJUST_PITCH(sz, dst.bpitchy);
 	sz *= 16;			/* 16 lines */
-	if (dst.format == REN_NV12) {
+	if (dst.format == REN_NV12 || dst.format == REN_NV21) {
 		val |= 2 << 12;	/* CPL: YCbCr420 */
 		sz = sz * 3 / 2;
 	} else if (dst.format == REN_NV16) {
@@ -683,23 +698,13 @@ int main (int argc, char * argv[])
 		}
 	}
 
-	if (!viodev)
-		vio = shvio_open();
-	else
-		vio = shvio_open_named(viodev);
-
-	if (vio == 0) {
-		fprintf (stderr, "Error opening VIO\n");
-		goto exit_err;
-	}
-
 	while (1) {
 #ifdef DEBUG
 		fprintf (stderr, "%s: Converting frame %d\n", progname, frameno);
 #endif
 
 		/* Read input */
-		if ((nread = fread (inbuf[0], 1, input_size[0], infile[0])) != input_size[0]) {
+		if ((nread = surface_io (infile[0], &inbuf[0], 0)) != input_size[0]) {
 			if (nread == 0 && feof (infile[0])) {
 				break;
 			} else {
@@ -709,7 +714,7 @@ int main (int argc, char * argv[])
 		}
 
 		if (infilename[1] != NULL) {
-			if ((nread = fread (inbuf[1], 1, input_size[1], infile[1])) != input_size[1]) {
+			if ((nread = surface_io (infile[1], &inbuf[1], 0)) != input_size[1]) {
 				if (nread == 0 && feof (infile[1])) {
 					break;
 				} else {
@@ -743,7 +748,7 @@ int main (int argc, char * argv[])
 #endif
 
 		/* Write output */
-		if (outfile && fwrite (outbuf, 1, output_size, outfile) != output_size) {
+		if (outfile && surface_io (outfile, &outbuf, 1) != output_size) {
 				fprintf (stderr, "%s: error writing input file %s\n",
 					 progname, outfilename);
 		}
@@ -751,8 +756,6 @@ int main (int argc, char * argv[])
 		frameno++;
 	}
 
-	shvio_close (vio);
-
 #if defined(USE_MERAM_RA)
 	/* finialize the read-ahead cache */
 	uiomux_unregister(src[0].py);
@@ -773,11 +776,11 @@ int main (int argc, char * argv[])
 	meram_close(meram);
 #endif
 
-	uiomux_free (uiomux, uiores, src[0].py, input_size[0]);
+	shvio_surface_free (vio, &inbuf[0]);
 	if (infilename[1] != NULL)
-		uiomux_free (uiomux, uiores, src[1].py, input_size[1]);
-	uiomux_free (uiomux, uiores, dst.py, output_size);
-	uiomux_close (uiomux);
+		shvio_surface_free (vio, &inbuf[1]);
+	shvio_surface_free (vio, &outbuf);
+	shvio_close (vio);
 
 	if (infile[0] != stdin) fclose (infile[0]);
 	if (infilename[1] != NULL)
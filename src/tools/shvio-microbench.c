@@ -0,0 +1,514 @@
+/*
+ * Microbenchmark of the libshvio data path helpers.
+ *
+ * The surface helpers that run on every frame (plane copies, bounce buffer
+ * setup, selections, plane sizes and offsets) are linked in directly and run
+ * against a stand-in for UIOMux, so no device is needed. The cost of each is
+ * reported in CPU cycles per call and per byte, and can be saved and compared
+ * against a previous run.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+
+#include <uiomux/uiomux.h>
+#include "common.h"
+
+#define MAX_RESULTS	256
+#define CALL_BYTES	(64 << 20)	/* bytes copied by each timed run */
+#define SMALL_CALLS	200000		/* calls of each timed run of a small helper */
+
+struct result {
+	char name[64];
+	double per_call;
+	double per_byte;	/* < 0 if the helper does not copy */
+};
+
+static struct result baseline[MAX_RESULTS];
+static int nr_baseline;
+static FILE *save_fp;
+static int runs = 5;
+
+static int perf_fd = -1;
+static const char *unit = "cycles";
+
+static volatile size_t sink;
+
+static void
+usage (const char * progname)
+{
+	printf ("Usage: %s [options]\n", progname);
+	printf ("Measure the CPU cost of the libshvio data path helpers.\n");
+	printf ("\nOptions\n");
+	printf ("  -n, --runs n           Number of timed runs of each case; the fastest\n");
+	printf ("                         is reported [default: 5]\n");
+	printf ("  -o, --output file      Save the results to a file\n");
+	printf ("  -b, --baseline file    Compare the results with those saved in a file\n");
+	printf ("\nMiscellaneous options\n");
+	printf ("  -h, --help             Display this help and exit\n");
+	printf ("  -v, --version          Output version information and exit\n");
+	printf ("\n");
+	printf ("Please report bugs to <linux-sh@vger.kernel.org>\n");
+}
+
+/* Count CPU cycles of this thread, or fall back to nanoseconds */
+static void
+counter_open (void)
+{
+#if defined(__linux__) && defined(__NR_perf_event_open)
+	struct perf_event_attr attr;
+
+	memset (&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CPU_CYCLES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	perf_fd = syscall (__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	if (perf_fd < 0) {
+		fprintf (stderr, "No cycle counter, reporting nanoseconds\n");
+		unit = "ns";
+	}
+}
+
+static uint64_t
+counter_read (void)
+{
+	struct timespec now;
+	uint64_t count;
+
+	if (perf_fd >= 0 && read (perf_fd, &count, sizeof(count)) == sizeof(count))
+		return count;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static int
+load_baseline (const char * path)
+{
+	struct result *r;
+	FILE *fp = fopen (path, "r");
+
+	if (!fp) {
+		fprintf (stderr, "ERROR: Unable to open %s\n", path);
+		return -1;
+	}
+
+	while (nr_baseline < MAX_RESULTS) {
+		r = &baseline[nr_baseline];
+		if (fscanf (fp, "%63s %lf %lf", r->name, &r->per_call, &r->per_byte) != 3)
+			break;
+		nr_baseline++;
+	}
+
+	fclose (fp);
+	return 0;
+}
+
+static const struct result *
+find_baseline (const char * name)
+{
+	int i;
+
+	for (i=0; i<nr_baseline; i++) {
+		if (!strcmp (baseline[i].name, name))
+			return &baseline[i];
+	}
+
+	return NULL;
+}
+
+static void
+report (const char * name, uint64_t count, long calls, size_t bytes)
+{
+	const struct result *base = find_baseline (name);
+	struct result r;
+
+	snprintf (r.name, sizeof(r.name), "%s", name);
+	r.per_call = (double)count / calls;
+	r.per_byte = bytes ? (double)count / ((double)bytes * calls) : -1;
+
+	printf ("%-36s %10.1f %s/call", r.name, r.per_call, unit);
+	if (r.per_byte >= 0)
+		printf (" %7.3f %s/byte", r.per_byte, unit);
+	if (base && base->per_call > 0)
+		printf ("  %+6.1f%% vs %.1f",
+			(r.per_call - base->per_call) * 100 / base->per_call, base->per_call);
+	printf ("\n");
+
+	if (save_fp)
+		fprintf (save_fp, "%s %.3f %.6f\n", r.name, r.per_call, r.per_byte);
+}
+
+/* Formats covered by the cases, one of each plane layout */
+static const struct {
+	const char *name;
+	ren_vid_format_t fmt;
+} formats[] = {
+	{ "NV12",     REN_NV12 },
+	{ "YV12",     REN_YV12 },
+	{ "UYVY",     REN_UYVY },
+	{ "RGB565",   REN_RGB565 },
+	{ "ARGB8888", REN_ARGB32 },
+};
+
+#define NR_FORMATS (sizeof(formats) / sizeof(formats[0]))
+
+static const struct {
+	const char *name;
+	int w;
+	int h;
+} sizes[] = {
+	{ "QCIF", 176,  144 },
+	{ "QVGA", 320,  240 },
+	{ "VGA",  640,  480 },
+	{ "720p", 1280, 720 },
+};
+
+#define NR_SIZES (sizeof(sizes) / sizeof(sizes[0]))
+
+/* Source pitches for a width: the width, padded, and a power of two */
+static int
+pitch_for (int w, int kind)
+{
+	int p = 1;
+
+	switch (kind) {
+	case 0:
+		return w;
+	case 1:
+		return w + 64;
+	default:
+		while (p < w)
+			p <<= 1;
+		return p;
+	}
+}
+
+static const char *pitch_names[] = { "tight", "pad64", "pow2" };
+
+/* Set up a surface of one plane layout in a single buffer */
+static void *
+surface_init (struct ren_vid_surface * s, ren_vid_format_t fmt,
+	      int w, int h, int pitch, int hw)
+{
+	size_t y_len = size_y (fmt, pitch * h, 0);
+	size_t len = y_len + size_c (fmt, pitch * h, 0);
+	void *p;
+
+	memset (s, 0, sizeof(*s));
+	s->format = fmt;
+	s->w = w;
+	s->h = h;
+	s->pitch = pitch;
+
+	if (hw)
+		p = uiomux_malloc (NULL, 0, len, 32);
+	else if (posix_memalign (&p, 32, len) != 0)
+		p = NULL;
+	if (!p)
+		return NULL;
+	memset (p, 0x80, len);
+
+	s->py = p;
+	if (fmts[fmt].c_bpp) {
+		s->pc = (uint8_t *)p + y_len;
+		if (is_ycbcr_planar (fmt))
+			s->pc2 = (uint8_t *)s->pc + chroma_bpitch (fmt, pitch) *
+				(h / fmts[fmt].c_ss_vert);
+	}
+
+	return p;
+}
+
+static void
+surface_fini (struct ren_vid_surface * s, int hw)
+{
+	size_t len = size_y (s->format, s->pitch * s->h, 0) +
+		size_c (s->format, s->pitch * s->h, 0);
+
+	if (hw)
+		uiomux_free (NULL, 0, s->py, len);
+	else
+		free (s->py);
+}
+
+/* Bytes of the active area of a surface */
+static size_t
+active_bytes (const struct ren_vid_surface * s)
+{
+	return size_y (s->format, s->w * s->h, 0) + size_c (s->format, s->w * s->h, 0);
+}
+
+static void
+bench_copy_surface (void)
+{
+	struct ren_vid_surface src, dst;
+	char name[64];
+	uint64_t best, t;
+	unsigned int f, i;
+	size_t bytes;
+	long calls, n;
+	int kind, r;
+
+	for (f=0; f<NR_FORMATS; f++) {
+		for (i=0; i<NR_SIZES; i++) {
+			for (kind=0; kind<3; kind++) {
+				int w = sizes[i].w, h = sizes[i].h;
+
+				if (!surface_init (&src, formats[f].fmt, w, h, pitch_for (w, kind), 0))
+					return;
+				if (!surface_init (&dst, formats[f].fmt, w, h, w, 0)) {
+					surface_fini (&src, 0);
+					return;
+				}
+
+				bytes = active_bytes (&src);
+				calls = CALL_BYTES / bytes + 1;
+				best = UINT64_MAX;
+				for (r=0; r<runs; r++) {
+					t = counter_read ();
+					for (n=0; n<calls; n++)
+						copy_surface (&dst, &src);
+					t = counter_read () - t;
+					if (t < best)
+						best = t;
+				}
+
+				snprintf (name, sizeof(name), "copy_surface/%s/%s/%s",
+					  formats[f].name, sizes[i].name, pitch_names[kind]);
+				report (name, best, calls, bytes);
+
+				surface_fini (&dst, 0);
+				surface_fini (&src, 0);
+			}
+		}
+	}
+}
+
+static void
+bench_get_hw_surface (void)
+{
+	struct ren_vid_surface in, out;
+	SHVIO vio;
+	char name[64];
+	uint64_t best, t;
+	unsigned int i;
+	long n;
+	int hw, r;
+
+	memset (&vio, 0, sizeof(vio));
+
+	for (i=0; i<NR_SIZES; i++) {
+		for (hw=1; hw>=0; hw--) {
+			if (!surface_init (&in, REN_NV12, sizes[i].w, sizes[i].h, sizes[i].w, hw))
+				return;
+
+			best = UINT64_MAX;
+			for (r=0; r<runs; r++) {
+				t = counter_read ();
+				for (n=0; n<SMALL_CALLS; n++) {
+					get_hw_surface (&vio, BOUNCE_SRC, &out, &in);
+					sink += (size_t)out.py;
+				}
+				t = counter_read () - t;
+				if (t < best)
+					best = t;
+			}
+
+			snprintf (name, sizeof(name), "get_hw_surface/NV12/%s/%s",
+				  sizes[i].name, hw ? "direct" : "bounce");
+			report (name, best, SMALL_CALLS, 0);
+
+			surface_fini (&in, hw);
+		}
+	}
+
+	release_bounce (&vio);
+}
+
+static void
+bench_get_sel_surface (void)
+{
+	struct ren_vid_surface in, out;
+	struct ren_vid_rect sel = { 17, 33, 320, 240 };
+	char name[64];
+	uint64_t best, t;
+	unsigned int f;
+	long n;
+	int r;
+
+	for (f=0; f<NR_FORMATS; f++) {
+		if (!surface_init (&in, formats[f].fmt, 640, 480, 640, 0))
+			return;
+
+		best = UINT64_MAX;
+		for (r=0; r<runs; r++) {
+			t = counter_read ();
+			for (n=0; n<SMALL_CALLS; n++) {
+				get_sel_surface (&out, &in, &sel);
+				sink += (size_t)out.py + (size_t)out.pc;
+			}
+			t = counter_read () - t;
+			if (t < best)
+				best = t;
+		}
+
+		snprintf (name, sizeof(name), "get_sel_surface/%s", formats[f].name);
+		report (name, best, SMALL_CALLS, 0);
+
+		surface_fini (&in, 0);
+	}
+}
+
+/* The size and offset helpers, over every format */
+static void
+bench_sizes (void)
+{
+	static const char *names[] = { "size_y", "size_c", "offset_y", "offset_c" };
+	volatile int w = 37, h = 41, pitch = 1024;
+	ren_vid_format_t fmt;
+	uint64_t best, t;
+	size_t acc = 0;
+	long calls = 0, n;
+	int k, r;
+
+	for (k=0; k<4; k++) {
+		best = UINT64_MAX;
+		for (r=0; r<runs; r++) {
+			calls = 0;
+			t = counter_read ();
+			for (n=0; n<SMALL_CALLS; n++) {
+				for (fmt=REN_NV12; fmt<=REN_VYUY; fmt++, calls++) {
+					switch (k) {
+					case 0: acc += size_y (fmt, w * h, 0); break;
+					case 1: acc += size_c (fmt, w * h, 0); break;
+					case 2: acc += offset_y (fmt, w, h, pitch); break;
+					default: acc += offset_c (fmt, w, h, pitch); break;
+					}
+				}
+			}
+			t = counter_read () - t;
+			if (t < best)
+				best = t;
+		}
+		report (names[k], best, calls, 0);
+	}
+
+	sink += acc;
+}
+
+int main (int argc, char * argv[])
+{
+	int show_version = 0;
+	int show_help = 0;
+	char * progname;
+	char * save_path = NULL;
+
+	int c;
+	char * optstring = "hvn:o:b:";
+
+#ifdef HAVE_GETOPT_LONG
+	static struct option long_options[] = {
+		{"help", no_argument, 0, 'h'},
+		{"version", no_argument, 0, 'v'},
+		{"runs", required_argument, 0, 'n'},
+		{"output", required_argument, 0, 'o'},
+		{"baseline", required_argument, 0, 'b'},
+		{NULL,0,0,0}
+	};
+#endif
+
+	progname = argv[0];
+
+	while (1) {
+#ifdef HAVE_GETOPT_LONG
+		c = getopt_long (argc, argv, optstring, long_options, NULL);
+#else
+		c = getopt (argc, argv, optstring);
+#endif
+		if (c == -1) break;
+		if (c == ':') {
+			usage (progname);
+			goto exit_err;
+		}
+
+		switch (c) {
+		case 'h': /* help */
+			show_help = 1;
+			break;
+		case 'v': /* version */
+			show_version = 1;
+			break;
+		case 'n': /* runs */
+			runs = atoi (optarg);
+			if (runs < 1) {
+				fprintf (stderr, "ERROR: Invalid number of runs\n");
+				goto exit_err;
+			}
+			break;
+		case 'o': /* output */
+			save_path = optarg;
+			break;
+		case 'b': /* baseline */
+			if (load_baseline (optarg) < 0)
+				goto exit_err;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (show_version) {
+		printf ("%s version " VERSION "\n", progname);
+	}
+
+	if (show_help) {
+		usage (progname);
+	}
+
+	if (show_version || show_help) {
+		goto exit_ok;
+	}
+
+	if (save_path) {
+		save_fp = fopen (save_path, "w");
+		if (!save_fp) {
+			fprintf (stderr, "ERROR: Unable to create %s\n", save_path);
+			goto exit_err;
+		}
+	}
+
+	counter_open ();
+
+	bench_sizes ();
+	bench_get_sel_surface ();
+	bench_get_hw_surface ();
+	bench_copy_surface ();
+
+	if (save_fp)
+		fclose (save_fp);
+	if (perf_fd >= 0)
+		close (perf_fd);
+
+exit_ok:
+	exit (0);
+
+exit_err:
+	exit (1);
+}
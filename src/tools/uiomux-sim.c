@@ -0,0 +1,116 @@
+/*
+ * A simulated VEU behind the UIOMux device functions, so that libshvio and
+ * shvio-bench can be run without the hardware. Its registers are plain
+ * memory. A job ends when libshvio sleeps on it, and moves a modelled clock
+ * on by a start-up cost and a cost per source pixel, so that the timings of
+ * a run only change when libshvio drives the device differently. Memory is
+ * left to uiomux-stub.c.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include <uiomux/uiomux.h>
+#include "veu_regs.h"
+
+#define SIM_ADDRESS	0xfe920000	/* where the registers would be */
+#define SIM_SIZE	0x400		/* neither a VEU2H nor a VEU3F */
+#define SIM_START_NS	20000		/* to start a job */
+#define SIM_PIXEL_NS	10		/* per source pixel, 100 Mpix/s */
+
+static uint32_t regs[SIM_SIZE / 4];
+static int lines_done;		/* of a frame run in bundles */
+static unsigned long long now_ns;
+
+#define REG(reg_nr)	regs[(reg_nr) / 4]
+
+/* The modelled time */
+void sim_clock(struct timespec *ts)
+{
+	ts->tv_sec = now_ns / 1000000000;
+	ts->tv_nsec = now_ns % 1000000000;
+}
+
+UIOMux *uiomux_open(void)
+{
+	return uiomux_open_named(NULL);
+}
+
+UIOMux *uiomux_open_named(const char *name[])
+{
+	if (name && name[0] && strncmp(name[0], "VEU", 3))
+		return NULL;
+
+	return regs;
+}
+
+void uiomux_close(UIOMux *uiomux)
+{
+}
+
+int uiomux_lock(UIOMux *uiomux, uiomux_resource_t resources)
+{
+	return 0;
+}
+
+int uiomux_unlock(UIOMux *uiomux, uiomux_resource_t resources)
+{
+	return 0;
+}
+
+int uiomux_get_mmio(UIOMux *uiomux, uiomux_resource_t resource,
+		    unsigned long *address, unsigned long *size, void **iomem)
+{
+	*address = SIM_ADDRESS;
+	*size = SIM_SIZE;
+	*iomem = regs;
+
+	return 1;
+}
+
+int uiomux_list_device(char ***names, int *count)
+{
+	static char *sim_names[] = { "VEU" };
+
+	*names = sim_names;
+	*count = 1;
+
+	return 0;
+}
+
+/* Run the started job to its end, or to the end of its bundle */
+int uiomux_sleep(UIOMux *uiomux, uiomux_resource_t resource)
+{
+	uint32_t vestr = REG(VESTR);
+	int w = REG(VESSR) & 0xffff;
+	int h = REG(VESSR) >> 16;
+	int lines = h;
+
+	if (!(vestr & 1))
+		return 0;
+
+	/* a module reset since the last job starts a new frame */
+	if (REG(VBSRR) & 0x100) {
+		REG(VBSRR) = 0;
+		lines_done = 0;
+	}
+
+	if (vestr & 0x100) {
+		lines = REG(VBSSR);
+		if (lines > h - lines_done)
+			lines = h - lines_done;
+	}
+	lines_done += lines;
+	now_ns += SIM_START_NS + (unsigned long long)w * lines * SIM_PIXEL_NS;
+
+	REG(VESTR) = 0;
+	if (lines_done >= h) {
+		lines_done = 0;
+		REG(VEVTR) = 1;
+	} else {
+		REG(VEVTR) = 0x100;
+	}
+
+	return 0;
+}
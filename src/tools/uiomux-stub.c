@@ -0,0 +1,92 @@
+/*
+ * Stand-in for the UIOMux memory functions, so that the data path helpers of
+ * libshvio can be run without a device. Memory from uiomux_malloc() and
+ * registered ranges count as accessible by the hardware, with the virtual
+ * address as the physical one; anything else does not.
+ */
+
+#include <stdlib.h>
+
+#include <uiomux/uiomux.h>
+
+struct stub_range {
+	unsigned long virt;
+	size_t size;
+	struct stub_range *next;
+};
+
+static struct stub_range *ranges;
+
+static int add_range(void *virt, size_t size)
+{
+	struct stub_range *r = malloc(sizeof(*r));
+
+	if (!r)
+		return -1;
+	r->virt = (unsigned long)virt;
+	r->size = size;
+	r->next = ranges;
+	ranges = r;
+
+	return 0;
+}
+
+static void remove_range(void *virt)
+{
+	struct stub_range **pr, *r;
+
+	for (pr = &ranges; (r = *pr) != NULL; pr = &r->next) {
+		if (r->virt == (unsigned long)virt) {
+			*pr = r->next;
+			free(r);
+			return;
+		}
+	}
+}
+
+void *uiomux_malloc(UIOMux *uiomux, uiomux_resource_t resource,
+		    size_t size, int align)
+{
+	void *p;
+
+	if (align < (int)sizeof(void *))
+		align = sizeof(void *);
+	if (posix_memalign(&p, align, size) != 0)
+		return NULL;
+	if (add_range(p, size) < 0) {
+		free(p);
+		return NULL;
+	}
+
+	return p;
+}
+
+void uiomux_free(UIOMux *uiomux, uiomux_resource_t resource,
+		 void *address, size_t size)
+{
+	remove_range(address);
+	free(address);
+}
+
+unsigned long uiomux_all_virt_to_phys(void *virt_address)
+{
+	unsigned long virt = (unsigned long)virt_address;
+	struct stub_range *r;
+
+	for (r = ranges; r; r = r->next) {
+		if (virt >= r->virt && virt < r->virt + r->size)
+			return virt;
+	}
+
+	return 0;
+}
+
+int uiomux_register(void *virt, unsigned long phys, size_t size)
+{
+	return add_range(virt, size);
+}
+
+void uiomux_unregister(void *virt)
+{
+	remove_range(virt);
+}